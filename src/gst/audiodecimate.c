@@ -0,0 +1,885 @@
+/*
+ * GstAudioDecimate
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * reduces the sample rate of F64 audio by an integer factor, for any
+ * input rate including non-integer (fractional) rates.  the factor is
+ * split into a cascade of stages:  as many half-band stages as there are
+ * factors of 2, each halving the rate with a filter in which every other
+ * tap is zero, followed by one Blackman-windowed sinc stage for the
+ * remainder which sets the final pass band.  if the factor is a power of
+ * 2 the last factor of 2 is taken by the windowed sinc stage.  all
+ * kernels are symmetric and centred on the output sample so the output
+ * is not delayed relative to its timestamps, and each stage extends its
+ * input at the ends by repeating the first and last samples.  the filters
+ * depend only on the factor, so a change of sample rate mid-stream keeps
+ * the cascade's history and only restarts the output timestamps.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <math.h>
+#include <string.h>
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+#include <gst/base/gstbasetransform.h>
+
+
+#include <settling.h>
+#include <audiodecimate.h>
+
+
+#define DEFAULT_FACTOR 1
+#define HALFBAND_HALF_LENGTH 31	/* input samples, odd */
+#define ZERO_CROSSINGS 16	/* per side of the final stage's kernel */
+#define ROLLOFF 0.95	/* cutoff / output Nyquist frequency */
+
+
+/*
+ * ============================================================================
+ *
+ *                                Boilerplate
+ *
+ * ============================================================================
+ */
+
+
+#define GST_CAT_DEFAULT gst_audiodecimate_debug
+GST_DEBUG_CATEGORY_STATIC(GST_CAT_DEFAULT);
+
+
+static void additional_initializations(void)
+{
+	GST_DEBUG_CATEGORY_INIT(GST_CAT_DEFAULT, "audiodecimate", 0, "audiodecimate element");
+}
+
+
+G_DEFINE_TYPE_WITH_CODE(GstAudioDecimate, gst_audiodecimate, GST_TYPE_BASE_TRANSFORM, additional_initializations(););
+
+
+/*
+ * ============================================================================
+ *
+ *                               Filter Stages
+ *
+ * ============================================================================
+ */
+
+
+/*
+ * one decimation stage.  output sample k is centred on input sample
+ * k * factor.  the kernel is symmetric, so only the centre tap and the
+ * taps at positive offsets are stored:  weights[0] multiplies the centre
+ * sample and weights[i], i > 0, the pair of samples at +/- offsets[i].
+ * taps that are zero are omitted, which for a half-band filter is every
+ * other one.
+ */
+
+
+struct decimate_stage {
+	gint factor;
+	gint half_length;	/* input samples */
+	gint n_taps;
+	gint *offsets;
+	gdouble *weights;
+
+	gdouble *history;	/* interleaved input samples */
+	guint64 history_length, history_size;	/* samples */
+	gint64 history_offset;	/* input sample index of history[0] */
+	guint64 in_samples;	/* input samples received since reset */
+	guint64 next_out;	/* index of next output sample */
+
+	gdouble *output;	/* interleaved output samples */
+	guint64 output_size;	/* samples */
+};
+
+
+static gdouble blackman(gdouble w)
+{
+	return fabs(w) >= 1.0 ? 0.0 : 0.42 + 0.5 * cos(M_PI * w) + 0.08 * cos(2.0 * M_PI * w);
+}
+
+
+static struct decimate_stage *stage_new(gint factor, gboolean halfband)
+{
+	struct decimate_stage *stage = g_new0(struct decimate_stage, 1);
+	gdouble cutoff;	/* cycles per input sample */
+	gdouble sum;
+	gint o, i;
+
+	stage->factor = factor;
+	if(halfband) {
+		cutoff = 0.25;
+		stage->half_length = HALFBAND_HALF_LENGTH;
+	} else {
+		cutoff = 0.5 * ROLLOFF / factor;
+		stage->half_length = ceil(ZERO_CROSSINGS / (2.0 * cutoff));
+	}
+	stage->offsets = g_new(gint, stage->half_length + 1);
+	stage->weights = g_new(gdouble, stage->half_length + 1);
+
+	for(o = 0, i = 0, sum = 0.0; o <= stage->half_length; o++) {
+		gdouble x = 2.0 * cutoff * o;
+
+		/* the half-band sinc is exactly 0 at even offsets */
+		if(halfband && o && !(o & 1))
+			continue;
+		stage->offsets[i] = o;
+		stage->weights[i] = (x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x)) * blackman((gdouble) o / (stage->half_length + 1));
+		sum += o ? 2.0 * stage->weights[i] : stage->weights[i];
+		i++;
+	}
+	stage->n_taps = i;
+
+	/* unit DC gain */
+	for(i = 0; i < stage->n_taps; i++)
+		stage->weights[i] /= sum;
+
+	return stage;
+}
+
+
+static void stage_free(struct decimate_stage *stage)
+{
+	if(stage) {
+		g_free(stage->offsets);
+		g_free(stage->weights);
+		g_free(stage->history);
+		g_free(stage->output);
+	}
+	g_free(stage);
+}
+
+
+static void stage_reset(struct decimate_stage *stage)
+{
+	stage->history_length = 0;
+	stage->in_samples = 0;
+	stage->next_out = 0;
+}
+
+
+static void stage_append(struct decimate_stage *stage, gint channels, const gdouble *data, guint64 n, guint64 repeat)
+{
+	guint64 i;
+
+	if(stage->history_length + n * repeat > stage->history_size) {
+		stage->history_size = MAX(stage->history_length + n * repeat, 2 * stage->history_size);
+		stage->history = g_realloc_n(stage->history, stage->history_size * channels, sizeof(*stage->history));
+	}
+	if(repeat == 1)
+		memcpy(stage->history + stage->history_length * channels, data, n * channels * sizeof(*data));
+	else
+		for(i = 0; i < repeat; i++)
+			memcpy(stage->history + (stage->history_length + i) * channels, data, channels * sizeof(*data));
+	stage->history_length += n * repeat;
+}
+
+
+/*
+ * absorb n input samples and compute as many output samples as the
+ * history allows into stage->output.  if drain is TRUE the input is
+ * extended by repeating its last sample so that every output sample up
+ * to the end of the input is computed.  returns the number of output
+ * samples.
+ */
+
+
+static guint64 stage_process(struct decimate_stage *stage, gint channels, const gdouble *data, guint64 n, gboolean drain)
+{
+	gint64 limit;	/* last input sample that can be the centre of a kernel */
+	gint64 first;
+	guint64 count, k;
+
+	if(n && !stage->in_samples) {
+		/* start of stream:  extend backwards with copies of the
+		 * first sample */
+		stage->history_offset = -stage->half_length;
+		stage_append(stage, channels, data, 1, stage->half_length);
+	}
+	if(n)
+		stage_append(stage, channels, data, n, 1);
+	stage->in_samples += n;
+
+	if(!stage->in_samples)
+		return 0;
+	if(drain) {
+		/* stage_append() may move the history, so copy the last
+		 * sample out of it first */
+		gdouble *last = g_newa(gdouble, channels);
+		memcpy(last, stage->history + (stage->history_length - 1) * channels, channels * sizeof(*last));
+		stage_append(stage, channels, last, 1, stage->half_length);
+		limit = stage->in_samples - 1;
+	} else
+		limit = (gint64) stage->in_samples - 1 - stage->half_length;
+	if(limit < 0)
+		return 0;
+	count = limit / stage->factor + 1;
+	if(count <= stage->next_out)
+		return 0;
+	count -= stage->next_out;
+
+	if(count > stage->output_size) {
+		stage->output_size = count;
+		stage->output = g_realloc_n(stage->output, stage->output_size * channels, sizeof(*stage->output));
+	}
+
+	for(k = 0; k < count; k++) {
+		const gdouble *x = stage->history + ((stage->next_out + k) * stage->factor - stage->history_offset) * channels;
+		gdouble *out = stage->output + k * channels;
+		gint i, c;
+
+		/* channels in the inner loop:  contiguous, independent, and
+		 * vectorizable */
+		for(c = 0; c < channels; c++)
+			out[c] = stage->weights[0] * x[c];
+		for(i = 1; i < stage->n_taps; i++) {
+			const gdouble w = stage->weights[i];
+			const gdouble *before = x - stage->offsets[i] * channels;
+			const gdouble *after = x + stage->offsets[i] * channels;
+			for(c = 0; c < channels; c++)
+				out[c] += w * (before[c] + after[c]);
+		}
+	}
+	stage->next_out += count;
+
+	/* discard history no longer needed */
+	first = (gint64) (stage->next_out * stage->factor) - stage->half_length - stage->history_offset;
+	if(first > 0) {
+		first = MIN(first, (gint64) stage->history_length);
+		memmove(stage->history, stage->history + first * channels, (stage->history_length - first) * channels * sizeof(*stage->history));
+		stage->history_length -= first;
+		stage->history_offset += first;
+	}
+
+	return count;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                             Internal Functions
+ *
+ * ============================================================================
+ */
+
+
+static gboolean get_rate(GstStructure *s, gint *num, gint *den)
+{
+	*den = 1;
+	return gst_structure_get_int(s, "rate", num) || gst_structure_get_fraction(s, "rate", num, den);
+}
+
+
+static void free_stages(GstAudioDecimate *element)
+{
+	gint i;
+
+	for(i = 0; i < element->n_stages; i++)
+		stage_free(element->stages[i]);
+	g_free(element->stages);
+	element->stages = NULL;
+	element->n_stages = 0;
+}
+
+
+/*
+ * factor = 2^n * remainder.  half-band stages for the factors of 2, a
+ * windowed sinc stage for the remainder.
+ */
+
+
+static void build_stages(GstAudioDecimate *element, gint factor)
+{
+	gint halfbands = 0;
+	gint i;
+
+	free_stages(element);
+	if(factor <= 1)
+		return;
+
+	while(!(factor & 1)) {
+		factor >>= 1;
+		halfbands++;
+	}
+	if(factor == 1) {
+		/* the last stage sets the pass band, it can't be a
+		 * half-band stage */
+		factor = 2;
+		halfbands--;
+	}
+
+	element->n_stages = halfbands + 1;
+	element->stages = g_new(struct decimate_stage *, element->n_stages);
+	for(i = 0; i < halfbands; i++)
+		element->stages[i] = stage_new(2, TRUE);
+	element->stages[halfbands] = stage_new(factor, FALSE);
+}
+
+
+/*
+ * number of input samples on either side of an input sample that
+ * contribute to the output sample centred on it
+ */
+
+
+static guint64 reach(GstAudioDecimate *element)
+{
+	guint64 scale = 1, total = 0;
+	gint i;
+
+	for(i = 0; i < element->n_stages; i++) {
+		total += element->stages[i]->half_length * scale;
+		scale *= element->stages[i]->factor;
+	}
+
+	return total;
+}
+
+
+static void reset(GstAudioDecimate *element)
+{
+	gint i;
+
+	for(i = 0; i < element->n_stages; i++)
+		stage_reset(element->stages[i]);
+	element->pending = NULL;
+	element->pending_length = 0;
+	element->next_out = 0;
+	element->need_discont = TRUE;
+}
+
+
+/*
+ * run n input samples through the cascade.  the output is left in
+ * element->pending.
+ */
+
+
+static void process(GstAudioDecimate *element, const gdouble *data, guint64 n, gboolean drain)
+{
+	gint i;
+
+	for(i = 0; i < element->n_stages; i++) {
+		n = stage_process(element->stages[i], element->channels, data, n, drain);
+		data = element->stages[i]->output;
+	}
+	element->pending = data;
+	element->pending_length = n;
+}
+
+
+static void set_metadata(GstAudioDecimate *element, GstBuffer *buf, guint64 n)
+{
+	const guint64 k = element->next_out;
+
+	GST_BUFFER_PTS(buf) = element->t0 + gst_util_uint64_scale_round(k, (guint64) GST_SECOND * element->outrate_den, element->outrate_num);
+	GST_BUFFER_DURATION(buf) = element->t0 + gst_util_uint64_scale_round(k + n, (guint64) GST_SECOND * element->outrate_den, element->outrate_num) - GST_BUFFER_PTS(buf);
+	GST_BUFFER_OFFSET(buf) = element->offset0 + k;
+	GST_BUFFER_OFFSET_END(buf) = element->offset0 + k + n;
+	if(element->need_discont) {
+		GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DISCONT);
+		element->need_discont = FALSE;
+	}
+}
+
+
+/*
+ * flush the samples held in the cascade by extending the stream with
+ * copies of its last sample, push them, and reset.
+ */
+
+
+static GstFlowReturn drain(GstAudioDecimate *element)
+{
+	GstFlowReturn result = GST_FLOW_OK;
+
+	if(!element->n_stages || !element->stages[0]->in_samples)
+		goto done;
+
+	process(element, NULL, 0, TRUE);
+	GST_DEBUG_OBJECT(element, "draining %" G_GUINT64_FORMAT " samples", element->pending_length);
+	if(element->pending_length) {
+		GstBuffer *buf = gst_buffer_new_allocate(NULL, element->pending_length * element->channels * sizeof(gdouble), NULL);
+
+		gst_buffer_fill(buf, 0, element->pending, element->pending_length * element->channels * sizeof(gdouble));
+		set_metadata(element, buf, element->pending_length);
+		element->next_out += element->pending_length;
+		result = gst_pad_push(GST_BASE_TRANSFORM_SRC_PAD(element), buf);
+	}
+
+done:
+	reset(element);
+	return result;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                          GstBaseTransform Methods
+ *
+ * ============================================================================
+ */
+
+
+static gboolean get_unit_size(GstBaseTransform *trans, GstCaps *caps, gsize *size)
+{
+	gint channels;
+	gboolean success = gst_structure_get_int(gst_caps_get_structure(caps, 0), "channels", &channels);
+
+	/* can't use gst_audio_info_from_caps():  doesn't understand
+	 * non-integer sample rates */
+	if(success)
+		*size = channels * sizeof(gdouble);
+	else
+		GST_ERROR_OBJECT(trans, "could not parse caps %" GST_PTR_FORMAT, caps);
+
+	return success;
+}
+
+
+/*
+ * the rate is divided by the decimation factor going downstream and
+ * multiplied by it going upstream.  the result is an int if it is a
+ * whole number, otherwise a fraction.  rates that are not fixed are
+ * replaced with whatever the other pad's template allows.
+ */
+
+
+static void transform_rate(GstStructure *s, gint factor, GstPadDirection direction)
+{
+	gint num, den;
+
+	if(!get_rate(s, &num, &den)) {
+		gst_structure_remove_field(s, "rate");
+		return;
+	}
+	if(direction == GST_PAD_SINK)
+		gst_util_fraction_multiply(num, den, 1, factor, &num, &den);
+	else
+		gst_util_fraction_multiply(num, den, factor, 1, &num, &den);
+	if(den == 1)
+		gst_structure_set(s, "rate", G_TYPE_INT, num, NULL);
+	else
+		gst_structure_set(s, "rate", GST_TYPE_FRACTION, num, den, NULL);
+}
+
+
+static GstCaps *transform_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+{
+	GstAudioDecimate *element = GST_AUDIO_DECIMATE(trans);
+	GstCaps *tmpltcaps;
+	GstCaps *othercaps;
+	gint factor;
+	guint i;
+
+	GST_OBJECT_LOCK(element);
+	factor = element->factor;
+	GST_OBJECT_UNLOCK(element);
+
+	caps = gst_caps_copy(caps);
+	for(i = 0; i < gst_caps_get_size(caps); i++)
+		transform_rate(gst_caps_get_structure(caps, i), factor, direction);
+
+	switch(direction) {
+	case GST_PAD_SRC:
+		tmpltcaps = gst_pad_get_pad_template_caps(GST_BASE_TRANSFORM_SINK_PAD(trans));
+		break;
+
+	case GST_PAD_SINK:
+		tmpltcaps = gst_pad_get_pad_template_caps(GST_BASE_TRANSFORM_SRC_PAD(trans));
+		break;
+
+	default:
+		g_assert_not_reached();
+		GST_ELEMENT_ERROR(trans, CORE, NEGOTIATION, (NULL), ("invalid direction GST_PAD_UNKNOWN"));
+		gst_caps_unref(caps);
+		gst_caps_ref(GST_CAPS_NONE);
+		return GST_CAPS_NONE;
+	}
+	othercaps = gst_caps_intersect_full(caps, tmpltcaps, GST_CAPS_INTERSECT_FIRST);
+	gst_caps_unref(tmpltcaps);
+	gst_caps_unref(caps);
+
+	if(filter) {
+		caps = othercaps;
+		othercaps = gst_caps_intersect_full(filter, othercaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(caps);
+	}
+
+	GST_DEBUG_OBJECT(trans, "transformed to %" GST_PTR_FORMAT, othercaps);
+
+	return othercaps;
+}
+
+
+static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps)
+{
+	GstAudioDecimate *element = GST_AUDIO_DECIMATE(trans);
+	gint channels, inrate_num, inrate_den, outrate_num, outrate_den;
+	gint up, down;
+	gboolean success = TRUE;
+
+	success &= gst_structure_get_int(gst_caps_get_structure(incaps, 0), "channels", &channels);
+	success &= get_rate(gst_caps_get_structure(incaps, 0), &inrate_num, &inrate_den);
+	success &= get_rate(gst_caps_get_structure(outcaps, 0), &outrate_num, &outrate_den);
+	if(!success || inrate_num <= 0 || outrate_num <= 0) {
+		GST_ERROR_OBJECT(element, "failed to parse rates from incaps = %" GST_PTR_FORMAT ", outcaps = %" GST_PTR_FORMAT, incaps, outcaps);
+		return FALSE;
+	}
+	gst_util_fraction_multiply(inrate_num, inrate_den, outrate_den, outrate_num, &down, &up);
+	if(up != 1) {
+		GST_ERROR_OBJECT(element, "%d/%d Hz --> %d/%d Hz is not decimation by an integer factor", inrate_num, inrate_den, outrate_num, outrate_den);
+		return FALSE;
+	}
+
+	if(element->n_stages && element->stages[0]->in_samples && channels == element->channels && down == element->down) {
+		/*
+		 * rate change mid-stream.  the filters are unchanged, keep
+		 * the history and restart the output timestamps at the
+		 * next output sample.  for the filters' reach the output
+		 * is computed from a mixture of input samples at the old
+		 * and new rates
+		 */
+
+		element->t0 += gst_util_uint64_scale_round(element->next_out, (guint64) GST_SECOND * element->outrate_den, element->outrate_num);
+		element->offset0 += element->next_out;
+		element->next_out = 0;
+		element->outrate_num = outrate_num;
+		element->outrate_den = outrate_den;
+		settling_post(GST_ELEMENT(element), GST_CAT_DEFAULT, &element->settling_time, element->t0, gst_util_uint64_scale_round(reach(element), (guint64) GST_SECOND * inrate_den, inrate_num));
+		return TRUE;
+	}
+
+	if(element->n_stages && element->stages[0]->in_samples) {
+		if(channels == element->channels)
+			drain(element);
+		else
+			GST_WARNING_OBJECT(element, "channel count changed, discarding history");
+	}
+
+	element->channels = channels;
+	element->outrate_num = outrate_num;
+	element->outrate_den = outrate_den;
+	element->down = down;
+	build_stages(element, down);
+	reset(element);
+
+	GST_DEBUG_OBJECT(element, "%d/%d Hz --> %d/%d Hz:  factor %d in %d stage(s)", inrate_num, inrate_den, outrate_num, outrate_den, down, element->n_stages);
+
+	return TRUE;
+}
+
+
+static gboolean start(GstBaseTransform *trans)
+{
+	reset(GST_AUDIO_DECIMATE(trans));
+
+	return TRUE;
+}
+
+
+static gboolean stop(GstBaseTransform *trans)
+{
+	GstAudioDecimate *element = GST_AUDIO_DECIMATE(trans);
+
+	free_stages(element);
+	reset(element);
+
+	return TRUE;
+}
+
+
+static gboolean sink_event(GstBaseTransform *trans, GstEvent *event)
+{
+	GstAudioDecimate *element = GST_AUDIO_DECIMATE(trans);
+
+	switch(GST_EVENT_TYPE(event)) {
+	case GST_EVENT_EOS:
+		if(!gst_base_transform_is_passthrough(trans))
+			drain(element);
+		break;
+
+	case GST_EVENT_FLUSH_STOP:
+		reset(element);
+		break;
+
+	default:
+		break;
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(gst_audiodecimate_parent_class)->sink_event(trans, event);
+}
+
+
+/*
+ * the number of output samples depends on the history held in each
+ * stage, not just on the size of the input buffer, so the queued input
+ * is run through the cascade here and the output buffer sized
+ * accordingly.  an input buffer that completes no output samples
+ * produces no buffer.  returning GST_BASE_TRANSFORM_FLOW_DROPPED instead
+ * would have the next buffer marked as a discontinuity.  output is
+ * marked as one only after a drain, or if the input was
+ */
+
+
+static GstFlowReturn generate_output(GstBaseTransform *trans, GstBuffer **outbuf)
+{
+	GstAudioDecimate *element = GST_AUDIO_DECIMATE(trans);
+	GstBuffer *inbuf = trans->queued_buf;
+	GstFlowReturn result = GST_FLOW_OK;
+	GstMapInfo map;
+	guint64 n;
+
+	if(gst_base_transform_is_passthrough(trans))
+		return GST_BASE_TRANSFORM_CLASS(gst_audiodecimate_parent_class)->generate_output(trans, outbuf);
+
+	*outbuf = NULL;
+	if(!inbuf)
+		goto done;
+	trans->queued_buf = NULL;
+
+	if(GST_BUFFER_IS_DISCONT(inbuf)) {
+		if(element->stages[0]->in_samples) {
+			GST_DEBUG_OBJECT(element, "discontinuity at %" GST_TIME_FORMAT, GST_TIME_ARGS(GST_BUFFER_PTS(inbuf)));
+			result = drain(element);
+			if(result != GST_FLOW_OK)
+				goto unref;
+		}
+		element->need_discont = TRUE;
+	}
+
+	gst_buffer_map(inbuf, &map, GST_MAP_READ);
+	n = map.size / (element->channels * sizeof(gdouble));
+	if(n && !element->stages[0]->in_samples) {
+		element->t0 = GST_BUFFER_PTS_IS_VALID(inbuf) ? GST_BUFFER_PTS(inbuf) : 0;
+		element->offset0 = GST_BUFFER_OFFSET_IS_VALID(inbuf) ? GST_BUFFER_OFFSET(inbuf) / element->down : 0;
+	}
+	process(element, (const gdouble *) map.data, n, FALSE);
+	gst_buffer_unmap(inbuf, &map);
+
+	n = element->pending_length;
+	if(n) {
+		*outbuf = gst_buffer_new_allocate(NULL, n * element->channels * sizeof(gdouble), NULL);
+		gst_buffer_fill(*outbuf, 0, element->pending, n * element->channels * sizeof(gdouble));
+		set_metadata(element, *outbuf, n);
+		element->next_out += n;
+		element->pending_length = 0;
+	}
+
+unref:
+	gst_buffer_unref(inbuf);
+done:
+	return result;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                              GObject Methods
+ *
+ * ============================================================================
+ */
+
+
+enum property {
+	ARG_FACTOR = 1,
+	ARG_SETTLING_TIME,
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstAudioDecimate *element = GST_AUDIO_DECIMATE(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_FACTOR:
+		element->factor = g_value_get_int(value);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+
+	/* new factor takes effect at the next caps negotiation */
+	gst_base_transform_reconfigure_src(GST_BASE_TRANSFORM(element));
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstAudioDecimate *element = GST_AUDIO_DECIMATE(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_FACTOR:
+		g_value_set_int(value, element->factor);
+		break;
+
+	case ARG_SETTLING_TIME:
+		g_value_set_uint64(value, element->settling_time);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void finalize(GObject *object)
+{
+	GstAudioDecimate *element = GST_AUDIO_DECIMATE(object);
+
+	free_stages(element);
+
+	/*
+	 * chain to parent class' finalize() method
+	 */
+
+	G_OBJECT_CLASS(gst_audiodecimate_parent_class)->finalize(object);
+}
+
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SINK_NAME,
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (int) [1, MAX], " \
+			"layout = (string) interleaved; " \
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved"
+	)
+);
+
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SRC_NAME,
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (int) [1, MAX], " \
+			"layout = (string) interleaved; " \
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved"
+	)
+);
+
+
+static void gst_audiodecimate_class_init(GstAudioDecimateClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->set_property = GST_DEBUG_FUNCPTR(set_property);
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
+	gobject_class->finalize = GST_DEBUG_FUNCPTR(finalize);
+
+	transform_class->get_unit_size = GST_DEBUG_FUNCPTR(get_unit_size);
+	transform_class->transform_caps = GST_DEBUG_FUNCPTR(transform_caps);
+	transform_class->set_caps = GST_DEBUG_FUNCPTR(set_caps);
+	transform_class->start = GST_DEBUG_FUNCPTR(start);
+	transform_class->stop = GST_DEBUG_FUNCPTR(stop);
+	transform_class->sink_event = GST_DEBUG_FUNCPTR(sink_event);
+	transform_class->generate_output = GST_DEBUG_FUNCPTR(generate_output);
+	transform_class->passthrough_on_same_caps = TRUE;
+
+	gst_element_class_set_details_simple(element_class,
+		"Audio decimator",
+		"Filter/Converter/Audio",
+		"Reduces the sample rate of audio, including non-integer sample rates, by an integer factor with a cascade of half-band and windowed-sinc filters",
+		"Kipp Cannon <kipp.cannon@ligo.org>"
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_FACTOR,
+		g_param_spec_int(
+			"factor",
+			"factor",
+			"Decimation factor.  The output sample rate is the input sample rate divided by this.",
+			1, G_MAXINT, DEFAULT_FACTOR,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_SETTLING_TIME,
+		g_param_spec_uint64(
+			"settling-time",
+			"Settling time",
+			"Length of output affected by the most recent change of sample rate (ns).  A \"settling\" element message with \"timestamp\" and \"duration\" fields is posted at each change.",
+			0, G_MAXUINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
+}
+
+
+static void gst_audiodecimate_init(GstAudioDecimate *element)
+{
+	element->channels = 0;
+	element->down = 1;
+	element->stages = NULL;
+	element->n_stages = 0;
+	element->settling_time = 0;
+	reset(element);
+}
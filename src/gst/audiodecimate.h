@@ -0,0 +1,127 @@
+/*
+ * GstAudioDecimate
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __AUDIO_DECIMATE_H__
+#define __AUDIO_DECIMATE_H__
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+
+G_BEGIN_DECLS
+
+
+/*
+ * ============================================================================
+ *
+ *                                    Type
+ *
+ * ============================================================================
+ */
+
+
+#define GST_TYPE_AUDIO_DECIMATE \
+	(gst_audiodecimate_get_type())
+#define GST_AUDIO_DECIMATE(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_AUDIO_DECIMATE, GstAudioDecimate))
+#define GST_AUDIO_DECIMATE_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_AUDIO_DECIMATE, GstAudioDecimateClass))
+#define GST_AUDIO_DECIMATE_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_AUDIO_DECIMATE, GstAudioDecimateClass))
+#define GST_IS_AUDIO_DECIMATE(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_AUDIO_DECIMATE))
+#define GST_IS_AUDIO_DECIMATE_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_AUDIO_DECIMATE))
+
+
+struct decimate_stage;
+
+
+typedef struct _GstAudioDecimateClass GstAudioDecimateClass;
+typedef struct _GstAudioDecimate GstAudioDecimate;
+
+
+struct _GstAudioDecimateClass {
+	GstBaseTransformClass parent_class;
+};
+
+
+/**
+ * GstAudioDecimate
+ */
+
+
+struct _GstAudioDecimate {
+	GstBaseTransform basetransform;
+
+	gint factor;	/* input rate / output rate */
+
+	/*
+	 * negotiated format and filter cascade
+	 */
+
+	gint channels;
+	gint outrate_num, outrate_den;
+	gint down;	/* negotiated decimation factor */
+	struct decimate_stage **stages;
+	gint n_stages;
+
+	/*
+	 * stream state
+	 */
+
+	const gdouble *pending;	/* output of last stage */
+	guint64 pending_length;	/* samples */
+	GstClockTime t0;
+	guint64 offset0;
+	guint64 next_out;
+	gboolean need_discont;
+	GstClockTime settling_time;	/* after the most recent rate change */
+};
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+GType gst_audiodecimate_get_type(void);
+
+
+G_END_DECLS
+
+
+#endif	/* __AUDIO_DECIMATE_H__ */
@@ -19,6 +19,27 @@
  */
 
 
+/*
+ * resamples F64 audio between any two sample rates whose ratio is
+ * rational, including non-integer (fractional) rates, which audioresample
+ * does not accept.  the rates are reduced to output / input = up / down in
+ * lowest terms, and each output sample is computed with the phase of a
+ * Blackman-windowed sinc interpolation kernel selected by its exact
+ * position between input samples.  the kernels are tabulated unless there
+ * are too many phases.  the kernel is centred on the output sample, so the
+ * output lags the input by half_length input samples;  timestamps are
+ * corrected for this.  the stream is extended at its ends by repeating
+ * the first and last samples.  a change of sample rate mid-stream keeps
+ * the history:  the output grid is restarted at the input sample
+ * following the next output sample and only the kernels are rebuilt.
+ *
+ * gst-cardiac resamples the face time series with irregularresample,
+ * which takes each sample's time from its timestamp.  this element is for
+ * regularly sampled streams, e.g., wilddevine's output or a recording
+ * with a nominal rate, where it is exact and cheaper.
+ */
+
+
 /*
  * ============================================================================
  *
@@ -28,14 +49,25 @@
  */
 
 
+#include <math.h>
+#include <string.h>
+
+
 #include <glib.h>
 #include <gst/gst.h>
 #include <gst/audio/audio.h>
+#include <gst/base/gstbasetransform.h>
 
 
+#include <settling.h>
 #include <audiorationalresample.h>
 
 
+#define ZERO_CROSSINGS 16	/* per side of the kernel, at the cutoff frequency */
+#define ROLLOFF 0.95	/* cutoff / Nyquist frequency of lower rate */
+#define MAX_KERNEL_PHASES 4096
+
+
 /*
  * ============================================================================
  *
@@ -55,7 +87,7 @@ static void additional_initializations(void)
 }
 
 
-G_DEFINE_TYPE_WITH_CODE(GstAudioRationalResample, gst_audiorationalresample, GST_TYPE_BIN, additional_initializations(););
+G_DEFINE_TYPE_WITH_CODE(GstAudioRationalResample, gst_audiorationalresample, GST_TYPE_BASE_TRANSFORM, additional_initializations(););
 
 
 /*
@@ -67,64 +99,513 @@ G_DEFINE_TYPE_WITH_CODE(GstAudioRationalResample, gst_audiorationalresample, GST
  */
 
 
+static gboolean get_rate(GstStructure *s, gint *num, gint *den)
+{
+	*den = 1;
+	return gst_structure_get_int(s, "rate", num) || gst_structure_get_fraction(s, "rate", num, den);
+}
+
+
+/*
+ * interpolation kernel for output phase p.  tap i multiplies input sample
+ * j - half_length + 1 + i where j is the input sample at or preceding the
+ * output sample.  normalized to unit DC gain.
+ */
+
+
+static void make_kernel(GstAudioRationalResample *element, gint p, gdouble *kernel)
+{
+	const gint n = 2 * element->half_length;
+	const gdouble frac = (gdouble) p / element->up;
+	gdouble sum = 0.0;
+	gint i;
+
+	for(i = 0; i < n; i++) {
+		gdouble t = i - element->half_length + 1 - frac;
+		gdouble x = 2.0 * element->cutoff * t;
+		gdouble w = t / element->half_length;
+		kernel[i] = (x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x));
+		kernel[i] *= fabs(w) >= 1.0 ? 0.0 : 0.42 + 0.5 * cos(M_PI * w) + 0.08 * cos(2.0 * M_PI * w);
+		sum += kernel[i];
+	}
+	for(i = 0; i < n; i++)
+		kernel[i] /= sum;
+}
+
+
+static void reset(GstAudioRationalResample *element)
+{
+	element->history_length = 0;
+	element->in_samples = 0;
+	element->next_out = 0;
+	element->need_discont = TRUE;
+}
+
+
+static void append_samples(GstAudioRationalResample *element, const gdouble *data, guint64 n, guint64 repeat)
+{
+	const gint channels = element->channels;
+	guint64 i;
+
+	if(element->history_length + n * repeat > element->history_size) {
+		element->history_size = MAX(element->history_length + n * repeat, 2 * element->history_size);
+		element->history = g_realloc_n(element->history, element->history_size * channels, sizeof(*element->history));
+	}
+	if(repeat == 1)
+		memcpy(element->history + element->history_length * channels, data, n * channels * sizeof(*data));
+	else
+		for(i = 0; i < repeat; i++)
+			memcpy(element->history + (element->history_length + i) * channels, data, channels * sizeof(*data));
+	element->history_length += n * repeat;
+}
+
+
+/*
+ * extend the history backwards by n copies of its first sample
+ */
+
+
+static void prepend_samples(GstAudioRationalResample *element, guint64 n)
+{
+	const gint channels = element->channels;
+	guint64 i;
+
+	if(element->history_length + n > element->history_size) {
+		element->history_size = MAX(element->history_length + n, 2 * element->history_size);
+		element->history = g_realloc_n(element->history, element->history_size * channels, sizeof(*element->history));
+	}
+	memmove(element->history + n * channels, element->history, element->history_length * channels * sizeof(*element->history));
+	for(i = 0; i < n; i++)
+		memcpy(element->history + i * channels, element->history + n * channels, channels * sizeof(*element->history));
+	element->history_length += n;
+	element->history_offset -= n;
+}
+
+
 /*
- * caps_notify_handler()
+ * number of output samples that can be computed once input samples up to
+ * but not including index limit are available
+ */
+
+
+static guint64 available(GstAudioRationalResample *element, gint64 limit)
+{
+	guint64 end;
+
+	if(limit <= 0)
+		return 0;
+	end = gst_util_uint64_scale_int_ceil(limit, element->up, element->down);
+	return end > element->next_out ? end - element->next_out : 0;
+}
+
+
+static void resample(GstAudioRationalResample *element, gdouble *out, guint64 n)
+{
+	const gint channels = element->channels;
+	const gint taps = 2 * element->half_length;
+	guint64 k;
+
+	for(k = element->next_out; k < element->next_out + n; k++, out += channels) {
+		guint64 pos = k * element->down;
+		gint64 j = pos / element->up;
+		gint p = pos % element->up;
+		const gdouble *x = element->history + (j - element->half_length + 1 - element->history_offset) * channels;
+		const gdouble *kernel;
+		gint i, c;
+
+		if(element->kernels)
+			kernel = element->kernels + p * taps;
+		else {
+			make_kernel(element, p, element->scratch);
+			kernel = element->scratch;
+		}
+
+		/* channels in the inner loop:  contiguous, independent, and
+		 * vectorizable */
+		memset(out, 0, channels * sizeof(*out));
+		for(i = 0; i < taps; i++, x += channels) {
+			const gdouble w = kernel[i];
+			for(c = 0; c < channels; c++)
+				out[c] += w * x[c];
+		}
+	}
+}
+
+
+/*
+ * discard history no longer needed to compute the next output sample
+ */
+
+
+static void trim_history(GstAudioRationalResample *element)
+{
+	gint64 first = (gint64) (element->next_out * element->down / element->up) - element->half_length + 1;
+	gint64 drop = first - element->history_offset;
+
+	if(drop <= 0)
+		return;
+	drop = MIN(drop, (gint64) element->history_length);
+	memmove(element->history, element->history + drop * element->channels, (element->history_length - drop) * element->channels * sizeof(*element->history));
+	element->history_length -= drop;
+	element->history_offset += drop;
+}
+
+
+static void set_metadata(GstAudioRationalResample *element, GstBuffer *buf, guint64 n)
+{
+	const guint64 k = element->next_out;
+
+	GST_BUFFER_PTS(buf) = element->t0 + gst_util_uint64_scale_round(k, (guint64) GST_SECOND * element->outrate_den, element->outrate_num);
+	GST_BUFFER_DURATION(buf) = element->t0 + gst_util_uint64_scale_round(k + n, (guint64) GST_SECOND * element->outrate_den, element->outrate_num) - GST_BUFFER_PTS(buf);
+	GST_BUFFER_OFFSET(buf) = element->offset0 + k;
+	GST_BUFFER_OFFSET_END(buf) = element->offset0 + k + n;
+	if(element->need_discont) {
+		GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DISCONT);
+		element->need_discont = FALSE;
+	}
+}
+
+
+/*
+ * compute the output samples that depend on the stream's final
+ * half_length input samples by extending it with copies of the last
+ * sample, push them, and reset.
+ */
+
+
+static GstFlowReturn drain(GstAudioRationalResample *element)
+{
+	GstFlowReturn result = GST_FLOW_OK;
+	gdouble *last;
+	guint64 n;
+
+	if(!element->in_samples)
+		goto done;
+
+	/* append_samples() may move the history, so copy the last sample
+	 * out of it first */
+	last = g_newa(gdouble, element->channels);
+	memcpy(last, element->history + (element->history_length - 1) * element->channels, element->channels * sizeof(*last));
+	append_samples(element, last, 1, element->half_length);
+	n = available(element, element->in_samples);
+	GST_DEBUG_OBJECT(element, "draining %" G_GUINT64_FORMAT " samples", n);
+	if(n) {
+		GstBuffer *buf = gst_buffer_new_allocate(NULL, n * element->channels * sizeof(gdouble), NULL);
+		GstMapInfo map;
+
+		gst_buffer_map(buf, &map, GST_MAP_WRITE);
+		resample(element, (gdouble *) map.data, n);
+		gst_buffer_unmap(buf, &map);
+		set_metadata(element, buf, n);
+		element->next_out += n;
+		result = gst_pad_push(GST_BASE_TRANSFORM_SRC_PAD(element), buf);
+	}
+
+done:
+	reset(element);
+	return result;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                          GstBaseTransform Methods
+ *
+ * ============================================================================
  */
 
 
-static void caps_notify_handler(GObject *object, GParamSpec *pspec, gpointer user_data)
+static gboolean get_unit_size(GstBaseTransform *trans, GstCaps *caps, gsize *size)
+{
+	gint channels;
+	gboolean success = gst_structure_get_int(gst_caps_get_structure(caps, 0), "channels", &channels);
+
+	/* can't use gst_audio_info_from_caps():  doesn't understand
+	 * non-integer sample rates */
+	if(success)
+		*size = channels * sizeof(gdouble);
+	else
+		GST_ERROR_OBJECT(trans, "could not parse caps %" GST_PTR_FORMAT, caps);
+
+	return success;
+}
+
+
+static GstCaps *transform_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+{
+	GstCaps *othercaps = NULL;
+	guint i;
+
+	/*
+	 * sink and source pads must have same channel count.  different
+	 * rates are permitted, but we should try to operate in
+	 * pass-through mode if possible.
+	 */
+
+	/* make a copy of caps with all rate elements removed */
+	othercaps = gst_caps_copy(caps);
+	for(i = 0; i < gst_caps_get_size(othercaps); i++)
+		gst_structure_remove_field(gst_caps_get_structure(othercaps, i), "rate");
+	/* append the result to a copy of caps, and free.  having the
+	 * original caps appear first informs peers of our desire to
+	 * operate in pass-through mode */
+	caps = gst_caps_copy(caps);
+	gst_caps_append(caps, othercaps);
+
+	/* intersect that result with the caps allowed by the pad template.
+	 * this repopulates the rate elements with the allowed ranges */
+	switch(direction) {
+	case GST_PAD_SRC: {
+		GstCaps *tmpltcaps = gst_pad_get_pad_template_caps(GST_BASE_TRANSFORM_SINK_PAD(trans));
+		othercaps = gst_caps_intersect_full(caps, tmpltcaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(tmpltcaps);
+		break;
+	}
+
+	case GST_PAD_SINK: {
+		GstCaps *tmpltcaps = gst_pad_get_pad_template_caps(GST_BASE_TRANSFORM_SRC_PAD(trans));
+		othercaps = gst_caps_intersect_full(caps, tmpltcaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(tmpltcaps);
+		break;
+	}
+
+	default:
+		g_assert_not_reached();
+		GST_ELEMENT_ERROR(trans, CORE, NEGOTIATION, (NULL), ("invalid direction GST_PAD_UNKNOWN"));
+		gst_caps_ref(GST_CAPS_NONE);
+		othercaps = GST_CAPS_NONE;
+		break;
+	}
+	gst_caps_unref(caps);
+
+	if(filter) {
+		caps = othercaps;
+		othercaps = gst_caps_intersect_full(filter, othercaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(caps);
+	}
+
+	GST_DEBUG_OBJECT(trans, "transformed to %" GST_PTR_FORMAT, othercaps);
+
+	return othercaps;
+}
+
+
+static GstCaps *fixate_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *othercaps)
 {
-	GstAudioRationalResample *element = GST_AUDIO_RATIONALRESAMPLE(gst_pad_get_parent(object));
-	GstCaps *incaps, *outcaps;
 	GstStructure *s;
-	gint inrate_num, inrate_den = 1;
-	gint outrate_num, outrate_den = 1;
+	gint rate_num, rate_den;
+
+	if(!get_rate(gst_caps_get_structure(caps, 0), &rate_num, &rate_den)) {
+		GST_ERROR_OBJECT(trans, "could not deduce rate from %" GST_PTR_FORMAT, caps);
+		return othercaps;
+	}
+
+	othercaps = gst_caps_truncate(othercaps);
+	s = gst_caps_get_structure(othercaps, 0);
+	if(gst_structure_has_field_typed(s, "rate", G_TYPE_INT))
+		gst_structure_fixate_field_nearest_int(s, "rate", rate_den == 1 ? rate_num : (int) round((double) rate_num / rate_den));
+	else if(gst_structure_has_field_typed(s, "rate", GST_TYPE_FRACTION))
+		gst_structure_fixate_field_nearest_fraction(s, "rate", rate_num, rate_den);
+
+	return gst_caps_fixate(othercaps);
+}
+
+
+static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps)
+{
+	GstAudioRationalResample *element = GST_AUDIO_RATIONALRESAMPLE(trans);
+	gint channels, inrate_num, inrate_den, outrate_num, outrate_den;
+	gint taps, p;
+	gboolean rebase = FALSE, inrate_changed = FALSE;
 	gboolean success = TRUE;
 
-	incaps = gst_pad_get_current_caps(element->sinkpad);
-	outcaps = gst_pad_get_current_caps(element->srcpad);
-	GST_DEBUG_OBJECT(element, "incaps = %" GST_PTR_FORMAT ", outcaps = %" GST_PTR_FORMAT, incaps, outcaps);
+	success &= gst_structure_get_int(gst_caps_get_structure(incaps, 0), "channels", &channels);
+	success &= get_rate(gst_caps_get_structure(incaps, 0), &inrate_num, &inrate_den);
+	success &= get_rate(gst_caps_get_structure(outcaps, 0), &outrate_num, &outrate_den);
+	if(!success || inrate_num <= 0 || outrate_num <= 0) {
+		GST_ERROR_OBJECT(element, "failed to parse rates from incaps = %" GST_PTR_FORMAT ", outcaps = %" GST_PTR_FORMAT, incaps, outcaps);
+		return FALSE;
+	}
 
-	if(!incaps || !outcaps) {
-		GST_DEBUG_OBJECT(element, "incomplete caps, not continuing with configuration");
-		goto done;
+	if(element->in_samples && channels == element->channels) {
+		/*
+		 * rate change mid-stream.  keep the history and restart
+		 * the output grid at the first input sample at or after
+		 * the next output sample, or at the next input sample if
+		 * that has not arrived yet.  input sample indexes are
+		 * renumbered from there
+		 */
+
+		guint64 origin = MIN(gst_util_uint64_scale_int_ceil(element->next_out, element->down, element->up), element->in_samples);
+
+		element->t0 += gst_util_uint64_scale_round(origin, (guint64) GST_SECOND * element->inrate_den, element->inrate_num);
+		element->offset0 += element->next_out;
+		element->history_offset -= origin;
+		element->in_samples -= origin;
+		element->next_out = 0;
+		rebase = TRUE;
+		inrate_changed = gst_util_fraction_compare(inrate_num, inrate_den, element->inrate_num, element->inrate_den) != 0;
+	} else {
+		if(element->in_samples)
+			GST_WARNING_OBJECT(element, "format changed, discarding %" G_GUINT64_FORMAT " samples of history", element->history_length);
+		reset(element);
+	}
+
+	element->channels = channels;
+	element->inrate_num = inrate_num;
+	element->inrate_den = inrate_den;
+	element->outrate_num = outrate_num;
+	element->outrate_den = outrate_den;
+	gst_util_fraction_multiply(outrate_num, outrate_den, inrate_den, inrate_num, &element->up, &element->down);
+
+	/*
+	 * design the filter
+	 */
+
+	element->cutoff = 0.5 * ROLLOFF * MIN(1.0, (gdouble) element->up / element->down);
+	element->half_length = ceil(ZERO_CROSSINGS / (2.0 * element->cutoff));
+	taps = 2 * element->half_length;
+
+	g_free(element->kernels);
+	element->kernels = NULL;
+	element->scratch = g_realloc_n(element->scratch, taps, sizeof(*element->scratch));
+	if(element->up <= MAX_KERNEL_PHASES) {
+		element->kernels = g_new(gdouble, element->up * taps);
+		for(p = 0; p < element->up; p++)
+			make_kernel(element, p, element->kernels + p * taps);
+	}
+
+	GST_DEBUG_OBJECT(element, "%d/%d Hz --> %d/%d Hz:  up = %d, down = %d, %d taps, cutoff = %g cycles/sample, %s kernels", inrate_num, inrate_den, outrate_num, outrate_den, element->up, element->down, taps, element->cutoff, element->kernels ? "tabulated" : "on-the-fly");
+
+	if(rebase) {
+		/* the output is disturbed for the kernel's reach into
+		 * input at the new rate if that changed, or for as much
+		 * history as had to be made up if the kernel grew */
+		gint64 missing = element->history_offset - (1 - element->half_length);
+		guint64 settling = 0;
+
+		if(missing > 0 && element->history_length) {
+			prepend_samples(element, missing);
+			settling = missing;
+		}
+		if(inrate_changed)
+			settling = MAX(settling, (guint64) element->half_length);
+		settling_post(GST_ELEMENT(element), GST_CAT_DEFAULT, &element->settling_time, element->t0, gst_util_uint64_scale_round(settling, (guint64) GST_SECOND * inrate_den, inrate_num));
 	}
 
-	s = gst_caps_get_structure(incaps, 0);
-	if(!gst_structure_get_int(s, "rate", &inrate_num))
-		success &= gst_structure_get_fraction(s, "rate", &inrate_num, &inrate_den);
+	return TRUE;
+}
+
+
+static gboolean start(GstBaseTransform *trans)
+{
+	reset(GST_AUDIO_RATIONALRESAMPLE(trans));
 
-	s = gst_caps_get_structure(outcaps, 0);
-	if(!gst_structure_get_int(s, "rate", &outrate_num))
-		success &= gst_structure_get_fraction(s, "rate", &outrate_num, &outrate_den);
+	return TRUE;
+}
 
-	if(success) {
-		/* least common multiple of denominators = smallest
-		 * multiplicative factor that makes both in and out rates
-		 * integers */
-		gint den_lcm = inrate_den / gst_util_greatest_common_divisor(inrate_den, outrate_den) * outrate_den;
 
-		GST_DEBUG_OBJECT(element, "input rate %d/%d, output rate %d/%d, denominators' least common multiple = %d", inrate_num, inrate_den, outrate_num, outrate_den, den_lcm);
+static gboolean stop(GstBaseTransform *trans)
+{
+	GstAudioRationalResample *element = GST_AUDIO_RATIONALRESAMPLE(trans);
 
-		/* multiply in and out rates by den_lcm.  makes both integers,
-		 * so can evalute ratios */
-		inrate_num *= den_lcm / inrate_den;
-		outrate_num *= den_lcm / outrate_den;
+	g_free(element->history);
+	element->history = NULL;
+	element->history_size = 0;
+	reset(element);
+
+	return TRUE;
+}
+
+
+static gboolean sink_event(GstBaseTransform *trans, GstEvent *event)
+{
+	GstAudioRationalResample *element = GST_AUDIO_RATIONALRESAMPLE(trans);
 
-		GST_DEBUG_OBJECT(element, "audioresample will believe input rate is %d, output rate is %d", inrate_num, outrate_num);
+	switch(GST_EVENT_TYPE(event)) {
+	case GST_EVENT_EOS:
+		if(!gst_base_transform_is_passthrough(trans))
+			drain(element);
+		break;
 
-		/* make rate fakers to do their thing */
-		g_object_set(element->precaps, "caps", gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, inrate_num, NULL), NULL);
-		g_object_set(element->postcaps, "caps", gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, outrate_num, NULL), NULL);
-	} else
-		GST_ERROR_OBJECT(element, "could not determine input and/or output sample rates");
+	case GST_EVENT_FLUSH_STOP:
+		reset(element);
+		break;
 
+	default:
+		break;
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(gst_audiorationalresample_parent_class)->sink_event(trans, event);
+}
+
+
+/*
+ * the number of output samples depends on the history, not just on the
+ * size of the input buffer, so the queued input is absorbed here and the
+ * output buffer sized accordingly.  when downsampling, small input
+ * buffers often complete no output samples;  those produce no buffer at
+ * all, so that, as in audiodecimate, output is marked as a discontinuity
+ * only after a drain or if the input was one
+ */
+
+
+static GstFlowReturn generate_output(GstBaseTransform *trans, GstBuffer **outbuf)
+{
+	GstAudioRationalResample *element = GST_AUDIO_RATIONALRESAMPLE(trans);
+	GstBuffer *inbuf = trans->queued_buf;
+	GstFlowReturn result = GST_FLOW_OK;
+	GstMapInfo map;
+	guint64 n;
+
+	if(gst_base_transform_is_passthrough(trans))
+		return GST_BASE_TRANSFORM_CLASS(gst_audiorationalresample_parent_class)->generate_output(trans, outbuf);
+
+	*outbuf = NULL;
+	if(!inbuf)
+		goto done;
+	trans->queued_buf = NULL;
+
+	if(GST_BUFFER_IS_DISCONT(inbuf)) {
+		if(element->in_samples) {
+			GST_DEBUG_OBJECT(element, "discontinuity at %" GST_TIME_FORMAT, GST_TIME_ARGS(GST_BUFFER_PTS(inbuf)));
+			result = drain(element);
+			if(result != GST_FLOW_OK)
+				goto unref;
+		}
+		element->need_discont = TRUE;
+	}
+
+	gst_buffer_map(inbuf, &map, GST_MAP_READ);
+	n = map.size / (element->channels * sizeof(gdouble));
+	if(n && !element->in_samples) {
+		/* start of stream:  extend backwards with copies of the
+		 * first sample */
+		element->t0 = GST_BUFFER_PTS_IS_VALID(inbuf) ? GST_BUFFER_PTS(inbuf) : 0;
+		element->offset0 = GST_BUFFER_OFFSET_IS_VALID(inbuf) ? gst_util_uint64_scale_int_round(GST_BUFFER_OFFSET(inbuf), element->up, element->down) : 0;
+		element->history_offset = -(element->half_length - 1);
+		append_samples(element, (const gdouble *) map.data, 1, element->half_length - 1);
+	}
+	append_samples(element, (const gdouble *) map.data, n, 1);
+	element->in_samples += n;
+	gst_buffer_unmap(inbuf, &map);
+
+	n = available(element, (gint64) element->in_samples - element->half_length);
+	if(n) {
+		*outbuf = gst_buffer_new_allocate(NULL, n * element->channels * sizeof(gdouble), NULL);
+		gst_buffer_map(*outbuf, &map, GST_MAP_WRITE);
+		resample(element, (gdouble *) map.data, n);
+		gst_buffer_unmap(*outbuf, &map);
+		set_metadata(element, *outbuf, n);
+		element->next_out += n;
+		trim_history(element);
+	}
+
+unref:
+	gst_buffer_unref(inbuf);
 done:
-	if(incaps)
-		gst_caps_unref(incaps);
-	if(outcaps)
-		gst_caps_unref(outcaps);
-	gst_object_unref(element);
+	return result;
 }
 
 
@@ -137,70 +618,141 @@ done:
  */
 
 
+enum property {
+	ARG_SETTLING_TIME = 1,
+};
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstAudioRationalResample *element = GST_AUDIO_RATIONALRESAMPLE(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_SETTLING_TIME:
+		g_value_set_uint64(value, element->settling_time);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
 static void finalize(GObject *object)
 {
 	GstAudioRationalResample *element = GST_AUDIO_RATIONALRESAMPLE(object);
 
-	gst_object_unref(element->sinkpad);
-	element->sinkpad = NULL;
-	gst_object_unref(element->srcpad);
-	element->srcpad = NULL;
-	gst_object_unref(element->precaps);
-	element->precaps = NULL;
-	gst_object_unref(element->postcaps);
-	element->postcaps = NULL;
+	g_free(element->kernels);
+	element->kernels = NULL;
+	g_free(element->scratch);
+	element->scratch = NULL;
+	g_free(element->history);
+	element->history = NULL;
+
+	/*
+	 * chain to parent class' finalize() method
+	 */
 
 	G_OBJECT_CLASS(gst_audiorationalresample_parent_class)->finalize(object);
 }
 
 
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SINK_NAME,
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (int) [1, MAX], " \
+			"layout = (string) interleaved; " \
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved"
+	)
+);
+
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SRC_NAME,
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (int) [1, MAX], " \
+			"layout = (string) interleaved; " \
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved"
+	)
+);
+
+
 static void gst_audiorationalresample_class_init(GstAudioRationalResampleClass *klass)
 {
 	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
 	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
 
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
 	gobject_class->finalize = GST_DEBUG_FUNCPTR(finalize);
 
+	transform_class->get_unit_size = GST_DEBUG_FUNCPTR(get_unit_size);
+	transform_class->transform_caps = GST_DEBUG_FUNCPTR(transform_caps);
+	transform_class->fixate_caps = GST_DEBUG_FUNCPTR(fixate_caps);
+	transform_class->set_caps = GST_DEBUG_FUNCPTR(set_caps);
+	transform_class->start = GST_DEBUG_FUNCPTR(start);
+	transform_class->stop = GST_DEBUG_FUNCPTR(stop);
+	transform_class->sink_event = GST_DEBUG_FUNCPTR(sink_event);
+	transform_class->generate_output = GST_DEBUG_FUNCPTR(generate_output);
+	transform_class->passthrough_on_same_caps = TRUE;
+
 	gst_element_class_set_details_simple(element_class,
 		"Rational sample rate audio resampler",
 		"Filter/Converter/Audio",
-		"Resamples audio",
+		"Resamples audio between rational (including non-integer) sample rates with a polyphase windowed-sinc filter",
 		"Kipp Cannon <kipp.cannon@ligo.org>"
 	);
-}
-
-
-static void gst_audiorationalresample_init(GstAudioRationalResample *resample)
-{
-	GstBin *bin = GST_BIN(resample);
-	GstElement *element = GST_ELEMENT(resample);
-	GstElement *prefaker, *audioresample, *postfaker;
 
-	resample->sinkpad = gst_ghost_pad_new_no_target("sink", GST_PAD_SINK);
-	g_signal_connect_after(resample->sinkpad, "notify::caps", (GCallback) caps_notify_handler, NULL);
-	gst_object_ref(resample->sinkpad);	/* now two refs */
-	gst_element_add_pad(element, resample->sinkpad);	/* consume one ref */
-
-	resample->srcpad = gst_ghost_pad_new_no_target("src", GST_PAD_SRC);
-	g_signal_connect_after(resample->srcpad, "notify::caps", (GCallback) caps_notify_handler, NULL);
-	gst_object_ref(resample->srcpad);	/* now two refs */
-	gst_element_add_pad(element, resample->srcpad);	/* consume one ref */
-
-	resample->precaps = gst_element_factory_make("capsfilter", "precaps"),
-	resample->postcaps = gst_element_factory_make("capsfilter", "postcaps"),
-	gst_object_ref(resample->precaps);	/* now two refs */
-	gst_object_ref(resample->postcaps);	/* now two refs */
-	gst_bin_add_many(bin,
-		prefaker = gst_element_factory_make("audioratefaker", "prefaker"),
-		resample->precaps,	/* consume one ref */
-		audioresample = gst_element_factory_make("audioresample", "audioresample"),
-		resample->postcaps,	/* consume one ref */
-		postfaker = gst_element_factory_make("audioratefaker", "postfaker"),
-		NULL
+	g_object_class_install_property(
+		gobject_class,
+		ARG_SETTLING_TIME,
+		g_param_spec_uint64(
+			"settling-time",
+			"Settling time",
+			"Length of output affected by the most recent change of sample rate (ns).  A \"settling\" element message with \"timestamp\" and \"duration\" fields is posted at each change.",
+			0, G_MAXUINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
 	);
 
-	gst_ghost_pad_set_target(GST_GHOST_PAD(resample->sinkpad), gst_element_get_static_pad(prefaker, "sink"));
-	gst_ghost_pad_set_target(GST_GHOST_PAD(resample->srcpad), gst_element_get_static_pad(postfaker, "src"));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
+}
 
-	gst_element_link_many(prefaker, resample->precaps, audioresample, resample->postcaps, postfaker, NULL);
+
+static void gst_audiorationalresample_init(GstAudioRationalResample *element)
+{
+	element->channels = 0;
+	element->up = element->down = 1;
+	element->half_length = 1;
+	element->kernels = NULL;
+	element->scratch = NULL;
+	element->history = NULL;
+	element->history_length = 0;
+	element->history_size = 0;
+	element->settling_time = 0;
+	reset(element);
 }
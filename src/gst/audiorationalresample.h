@@ -34,6 +34,7 @@
 
 #include <glib.h>
 #include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
 
 
 G_BEGIN_DECLS
@@ -67,7 +68,7 @@ typedef struct _GstAudioRationalResample GstAudioRationalResample;
 
 
 struct _GstAudioRationalResampleClass {
-	GstBinClass parent_class;
+	GstBaseTransformClass parent_class;
 };
 
 
@@ -77,12 +78,43 @@ struct _GstAudioRationalResampleClass {
 
 
 struct _GstAudioRationalResample {
-	GstBin bin;
-
-	GstPad *sinkpad;
-	GstPad *srcpad;
-	GstElement *precaps;
-	GstElement *postcaps;
+	GstBaseTransform basetransform;
+
+	/*
+	 * negotiated format.  output rate / input rate = up / down in
+	 * lowest terms
+	 */
+
+	gint channels;
+	gint inrate_num, inrate_den;
+	gint outrate_num, outrate_den;
+	gint up, down;
+
+	/*
+	 * filter.  kernels is an up x (2 * half_length) table of
+	 * interpolation kernels, one for each output phase, or NULL if
+	 * there are too many phases and the kernels are computed as
+	 * needed in scratch
+	 */
+
+	gint half_length;	/* input samples */
+	gdouble cutoff;	/* cycles per input sample */
+	gdouble *kernels;
+	gdouble *scratch;
+
+	/*
+	 * stream state
+	 */
+
+	gdouble *history;	/* interleaved input samples */
+	guint64 history_length, history_size;	/* samples */
+	gint64 history_offset;	/* input sample index of history[0] */
+	guint64 in_samples;	/* input samples received since reset */
+	guint64 next_out;	/* index of next output sample */
+	GstClockTime t0;
+	guint64 offset0;
+	gboolean need_discont;
+	GstClockTime settling_time;	/* after the most recent rate change */
 };
 
 
@@ -40,10 +40,17 @@
 
 
 #include <audiorationalresample.h>
+#include <irregularresample.h>
+#include <audiodecimate.h>
+#include <clockrecovery.h>
 #include <audioratefaker.h>
 #include <videoratefaker.h>
+#include <videodecimate.h>
 #include <face2rgb.h>
+#include <histogram2rgb.h>
 #include <faceprocessor.h>
+#include <easi.h>
+#include <fastica.h>
 
 
 /*
@@ -62,10 +69,17 @@ static gboolean plugin_init(GstPlugin *plugin)
 		GType type;
 	} *element, elements[] = {
 		{"audiorationalresample", GST_TYPE_AUDIO_RATIONALRESAMPLE},
+		{"irregularresample", GST_TYPE_IRREGULAR_RESAMPLE},
+		{"audiodecimate", GST_TYPE_AUDIO_DECIMATE},
+		{"clockrecovery", GST_TYPE_CLOCK_RECOVERY},
 		{"audioratefaker", GST_TYPE_AUDIO_RATE_FAKER},
 		{"videoratefaker", GST_TYPE_VIDEO_RATE_FAKER},
+		{"videodecimate", GST_TYPE_VIDEO_DECIMATE},
 		{"face2rgb", GST_TYPE_FACE_2_RGB},
+		{"histogram2rgb", GST_TYPE_HISTOGRAM_2_RGB},
 		{"faceprocessor", GST_TYPE_FACE_PROCESSOR},
+		{"fastica", GST_TYPE_FASTICA},
+		{"easi", GST_TYPE_EASI},
 		{NULL, 0},
 	};
 
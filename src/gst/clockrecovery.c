@@ -0,0 +1,447 @@
+/*
+ * GstClockRecovery
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * replaces the timestamps of a stream of buffers produced by a source with
+ * a uniform but unknown clock, e.g. the frames of a camera, with the
+ * times reconstructed by the software PLL in pll.c, which is also used by
+ * the wilddevine source.  each buffer is one tick of the clock, so this is
+ * meant for video and for sources with a fixed block size.  the PLL is
+ * reset at discontinuities.  a timestamp the PLL can't follow is counted
+ * as a fault and the PLL reacquires from it;  the output timestamps can
+ * then step backwards, so that buffer is marked as a discontinuity.
+ *
+ * sources like v4l2src drop frames when they fall behind.  once the PLL
+ * is locked, a buffer that arrives about n >= 1 periods late is taken to
+ * follow n dropped buffers:  the PLL is advanced by n ticks before it is
+ * corrected, so the drop neither disturbs the loop nor disappears from
+ * the output timestamps, and downstream elements that fill gaps from the
+ * timestamps, e.g., irregularresample, still see it.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <string.h>
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+
+#include <pll.h>
+#include <clockrecovery.h>
+
+
+#define DEFAULT_PHASE_GAIN PLL_DEFAULT_PHASE_GAIN
+#define DEFAULT_FREQUENCY_GAIN PLL_DEFAULT_FREQUENCY_GAIN
+
+
+/*
+ * ============================================================================
+ *
+ *                                Boilerplate
+ *
+ * ============================================================================
+ */
+
+
+#define GST_CAT_DEFAULT gst_clock_recovery_debug
+GST_DEBUG_CATEGORY_STATIC(GST_CAT_DEFAULT);
+
+
+static void additional_initializations(void)
+{
+	GST_DEBUG_CATEGORY_INIT(GST_CAT_DEFAULT, "clockrecovery", 0, "clockrecovery element");
+}
+
+
+G_DEFINE_TYPE_WITH_CODE(GstClockRecovery, gst_clock_recovery, GST_TYPE_BASE_TRANSFORM, additional_initializations(););
+
+
+/*
+ * ============================================================================
+ *
+ *                          GstBaseTransform Methods
+ *
+ * ============================================================================
+ */
+
+
+static gboolean start(GstBaseTransform *trans)
+{
+	GstClockRecovery *element = GST_CLOCK_RECOVERY(trans);
+
+	GST_OBJECT_LOCK(element);
+	element->pll = pll_new(element->phase_gain, element->frequency_gain);
+	element->locked = FALSE;
+	element->dropped = 0;
+	GST_OBJECT_UNLOCK(element);
+
+	return TRUE;
+}
+
+
+static gboolean stop(GstBaseTransform *trans)
+{
+	GstClockRecovery *element = GST_CLOCK_RECOVERY(trans);
+
+	GST_OBJECT_LOCK(element);
+	pll_free(element->pll);
+	element->pll = NULL;
+	GST_OBJECT_UNLOCK(element);
+
+	return TRUE;
+}
+
+
+static gboolean sink_event(GstBaseTransform *trans, GstEvent *event)
+{
+	GstClockRecovery *element = GST_CLOCK_RECOVERY(trans);
+
+	if(GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP) {
+		GST_OBJECT_LOCK(element);
+		pll_reset(element->pll);
+		GST_OBJECT_UNLOCK(element);
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(gst_clock_recovery_parent_class)->sink_event(trans, event);
+}
+
+
+static GstFlowReturn transform_ip(GstBaseTransform *trans, GstBuffer *buf)
+{
+	GstClockRecovery *element = GST_CLOCK_RECOVERY(trans);
+	gboolean locked, notify;
+	guint64 faults, missing;
+
+	if(!GST_BUFFER_PTS_IS_VALID(buf))
+		return GST_FLOW_OK;
+
+	GST_OBJECT_LOCK(element);
+	if(GST_BUFFER_IS_DISCONT(buf)) {
+		GST_DEBUG_OBJECT(element, "discontinuity at %" GST_TIME_FORMAT ", resetting PLL", GST_TIME_ARGS(GST_BUFFER_PTS(buf)));
+		pll_reset(element->pll);
+	}
+	if(!pll_period(element->pll) && GST_BUFFER_DURATION_IS_VALID(buf))
+		pll_set_period(element->pll, GST_BUFFER_DURATION(buf));
+	missing = pll_skip_missing(element->pll, GST_BUFFER_PTS(buf));
+	if(missing) {
+		GST_DEBUG_OBJECT(element, "%" G_GUINT64_FORMAT " buffer(s) missing before %" GST_TIME_FORMAT, missing, GST_TIME_ARGS(GST_BUFFER_PTS(buf)));
+		element->dropped += missing;
+	}
+	faults = pll_faults(element->pll);
+	GST_BUFFER_PTS(buf) = pll_correct(element->pll, GST_BUFFER_PTS(buf), &locked);
+	if(pll_faults(element->pll) != faults) {
+		/* reacquired from the raw timestamp, which can be earlier
+		 * than the previous output's */
+		GST_WARNING_OBJECT(element, "PLL cannot follow timestamp, reacquiring from %" GST_TIME_FORMAT, GST_TIME_ARGS(GST_BUFFER_PTS(buf)));
+		GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DISCONT);
+	}
+	if(pll_period(element->pll))
+		GST_BUFFER_DURATION(buf) = pll_period(element->pll);
+	notify = locked != element->locked;
+	element->locked = locked;
+	GST_OBJECT_UNLOCK(element);
+
+	if(notify) {
+		GST_INFO_OBJECT(element, locked ? "PLL locked" : "PLL unlocked");
+		g_object_notify(G_OBJECT(element), "locked");
+	}
+
+	return GST_FLOW_OK;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                              GObject Methods
+ *
+ * ============================================================================
+ */
+
+
+enum property {
+	ARG_PHASE_GAIN = 1,
+	ARG_FREQUENCY_GAIN,
+	ARG_LOCKED,
+	ARG_FREQUENCY,
+	ARG_PHASE_ERROR_RMS,
+	ARG_PHASE_ERROR_HISTOGRAM,
+	ARG_FAULTS,
+	ARG_DROPPED
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstClockRecovery *element = GST_CLOCK_RECOVERY(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_PHASE_GAIN:
+		element->phase_gain = g_value_get_double(value);
+		if(element->pll)
+			element->pll->phase_gain = element->phase_gain;
+		break;
+
+	case ARG_FREQUENCY_GAIN:
+		element->frequency_gain = g_value_get_double(value);
+		if(element->pll)
+			element->pll->frequency_gain = element->frequency_gain;
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstClockRecovery *element = GST_CLOCK_RECOVERY(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_PHASE_GAIN:
+		g_value_set_double(value, element->phase_gain);
+		break;
+
+	case ARG_FREQUENCY_GAIN:
+		g_value_set_double(value, element->frequency_gain);
+		break;
+
+	case ARG_LOCKED:
+		g_value_set_boolean(value, element->locked);
+		break;
+
+	case ARG_FREQUENCY:
+		g_value_set_double(value, element->pll ? pll_frequency(element->pll) : 0.0);
+		break;
+
+	case ARG_PHASE_ERROR_RMS:
+		g_value_set_double(value, element->pll ? pll_phase_error_rms(element->pll) : 0.0);
+		break;
+
+	case ARG_FAULTS:
+		g_value_set_uint64(value, element->pll ? pll_faults(element->pll) : 0);
+		break;
+
+	case ARG_DROPPED:
+		g_value_set_uint64(value, element->dropped);
+		break;
+
+	case ARG_PHASE_ERROR_HISTOGRAM: {
+		GArray *histogram = g_array_sized_new(FALSE, TRUE, sizeof(guint64), PLL_HISTOGRAM_BINS);
+		g_array_set_size(histogram, PLL_HISTOGRAM_BINS);
+		if(element->pll)
+			memcpy(histogram->data, pll_phase_error_histogram(element->pll), PLL_HISTOGRAM_BINS * sizeof(guint64));
+		g_value_take_boxed(value, histogram);
+		break;
+	}
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void finalize(GObject *object)
+{
+	GstClockRecovery *element = GST_CLOCK_RECOVERY(object);
+
+	if(element->pll)
+		pll_free(element->pll);
+	element->pll = NULL;
+
+	/*
+	 * chain to parent class' finalize() method
+	 */
+
+	G_OBJECT_CLASS(gst_clock_recovery_parent_class)->finalize(object);
+}
+
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SINK_NAME,
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS_ANY
+);
+
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SRC_NAME,
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS_ANY
+);
+
+
+static void gst_clock_recovery_class_init(GstClockRecoveryClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->set_property = GST_DEBUG_FUNCPTR(set_property);
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
+	gobject_class->finalize = GST_DEBUG_FUNCPTR(finalize);
+
+	transform_class->start = GST_DEBUG_FUNCPTR(start);
+	transform_class->stop = GST_DEBUG_FUNCPTR(stop);
+	transform_class->sink_event = GST_DEBUG_FUNCPTR(sink_event);
+	transform_class->transform_ip = GST_DEBUG_FUNCPTR(transform_ip);
+
+	gst_element_class_set_details_simple(element_class,
+		"Clock recovery",
+		"Filter",
+		"Replaces jittery buffer timestamps with those of a software PLL locked to the source's sample clock.",
+		"Kipp Cannon <kipp.cannon@ligo.org>"
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_PHASE_GAIN,
+		g_param_spec_double(
+			"phase-gain",
+			"Phase gain",
+			"Fraction of each timing error fed back into the phase.  Smaller values narrow the loop bandwidth, rejecting more jitter but tracking drift more slowly.",
+			0, 1, DEFAULT_PHASE_GAIN,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_FREQUENCY_GAIN,
+		g_param_spec_double(
+			"frequency-gain",
+			"Frequency gain",
+			"Fraction of each timing error fed back into the period.",
+			0, 1, DEFAULT_FREQUENCY_GAIN,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_LOCKED,
+		g_param_spec_boolean(
+			"locked",
+			"PLL Locked",
+			"Clock reconstruction is stable.",
+			FALSE,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_FREQUENCY,
+		g_param_spec_double(
+			"frequency",
+			"Frequency",
+			"Estimated frequency of the source's clock (Hz).",
+			0, G_MAXDOUBLE, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_PHASE_ERROR_RMS,
+		g_param_spec_double(
+			"phase-error-rms",
+			"RMS phase error",
+			"RMS difference between the input timestamps and the PLL's prediction (periods).",
+			0, G_MAXDOUBLE, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_PHASE_ERROR_HISTOGRAM,
+		g_param_spec_boxed(
+			"phase-error-histogram",
+			"Phase error histogram",
+			"GArray of " G_STRINGIFY(PLL_HISTOGRAM_BINS) " guint64 counts of the phase error in equal bins from -1 to +1 periods.  Errors outside that range are counted in the end bins.",
+			G_TYPE_ARRAY,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_FAULTS,
+		g_param_spec_uint64(
+			"faults",
+			"Faults",
+			"Number of buffers whose timestamps the PLL could not follow, e.g. out of order or stepped backwards.  The PLL reacquires from each.",
+			0, G_MAXUINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_DROPPED,
+		g_param_spec_uint64(
+			"dropped",
+			"Dropped",
+			"Number of buffers the source is inferred to have dropped from gaps of whole periods in the input timestamps.  The gaps are kept in the output timestamps.",
+			0, G_MAXUINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
+}
+
+
+static void gst_clock_recovery_init(GstClockRecovery *element)
+{
+	gst_base_transform_set_in_place(GST_BASE_TRANSFORM(element), TRUE);
+	gst_base_transform_set_gap_aware(GST_BASE_TRANSFORM(element), TRUE);
+
+	element->pll = NULL;
+	element->locked = FALSE;
+	element->dropped = 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * GstClockRecovery
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __CLOCK_RECOVERY_H__
+#define __CLOCK_RECOVERY_H__
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+
+#include <pll.h>
+
+
+G_BEGIN_DECLS
+
+
+/*
+ * ============================================================================
+ *
+ *                                    Type
+ *
+ * ============================================================================
+ */
+
+
+#define GST_TYPE_CLOCK_RECOVERY \
+	(gst_clock_recovery_get_type())
+#define GST_CLOCK_RECOVERY(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_CLOCK_RECOVERY, GstClockRecovery))
+#define GST_CLOCK_RECOVERY_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_CLOCK_RECOVERY, GstClockRecoveryClass))
+#define GST_CLOCK_RECOVERY_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_CLOCK_RECOVERY, GstClockRecoveryClass))
+#define GST_IS_CLOCK_RECOVERY(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_CLOCK_RECOVERY))
+#define GST_IS_CLOCK_RECOVERY_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_CLOCK_RECOVERY))
+
+
+typedef struct _GstClockRecoveryClass GstClockRecoveryClass;
+typedef struct _GstClockRecovery GstClockRecovery;
+
+
+struct _GstClockRecoveryClass {
+	GstBaseTransformClass parent_class;
+};
+
+
+/**
+ * GstClockRecovery
+ */
+
+
+struct _GstClockRecovery {
+	GstBaseTransform basetransform;
+
+	gdouble phase_gain;
+	gdouble frequency_gain;
+
+	struct pll *pll;
+	gboolean locked;
+	guint64 dropped;
+};
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+GType gst_clock_recovery_get_type(void);
+
+
+G_END_DECLS
+
+
+#endif	/* __CLOCK_RECOVERY_H__ */
@@ -0,0 +1,575 @@
+/*
+ * GstEASI
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * unmixes face2rgb's forehead and cheek R, G, B time series into
+ * independent components by adapting the unmixing matrix with every
+ * sample, using the normalized form of the EASI algorithm (Cardoso &
+ * Laheld 1996, IEEE Trans. Signal Process. 44, 3017).  with y = B x the
+ * current output, the update is
+ *
+ *	B -= mu [(y y^T - 1) / (1 + mu y^T y) + (g y^T - y g^T) / (1 + mu |y^T g|)] B
+ *
+ * the products with B are formed as outer products of y and g with the
+ * vectors y^T B and g^T B, so each sample costs O(n^2) and the memory
+ * used doesn't depend on the length of the stream.
+ *
+ * EASI needs a nonlinearity matched to the kind of each source:  g(y) =
+ * tanh(y) separates sub-Gaussian sources (the pulse), g(y) = -tanh(y)
+ * super-Gaussian ones (motion).  the sign for each component is chosen
+ * from a running estimate of E[y tanh(y) - sech^2(y)], as in extended
+ * infomax.
+ *
+ * the input is optionally differentiated, as rgb2ica.py does, and then
+ * normalized to zero mean and unit variance with running averages, so
+ * that the step size doesn't depend on the brightness of the face.  the
+ * unmixing matrix is either 3x3, adapted to the sum of the forehead and
+ * cheek streams and applied to each separately as rgb2ica.py does, or
+ * 6x6, adapted to and applied to all 6 channels jointly.  after each
+ * update its rows are put in the order and given the signs that the
+ * rules of rgb2ica.py's unmix_rgb() give them, so that channel meaning
+ * is stable.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <math.h>
+#include <string.h>
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+#include <gst/base/gstbasetransform.h>
+
+
+#include <easi.h>
+#include <ica.h>
+
+
+#define DEFAULT_STEP_SIZE 0.002
+#define DEFAULT_AVERAGING_TIME (10 * GST_SECOND)
+#define DEFAULT_JOINT FALSE
+#define DEFAULT_DIFFERENTIATE TRUE
+
+
+/*
+ * ============================================================================
+ *
+ *                                Boilerplate
+ *
+ * ============================================================================
+ */
+
+
+#define GST_CAT_DEFAULT gst_easi_debug
+GST_DEBUG_CATEGORY_STATIC(GST_CAT_DEFAULT);
+
+
+static void additional_initializations(void)
+{
+	GST_DEBUG_CATEGORY_INIT(GST_CAT_DEFAULT, "easi", 0, "easi element");
+}
+
+
+G_DEFINE_TYPE_WITH_CODE(GstEASI, gst_easi, GST_TYPE_BASE_TRANSFORM, additional_initializations(););
+
+
+/*
+ * ============================================================================
+ *
+ *                             Internal Functions
+ *
+ * ============================================================================
+ */
+
+
+static gboolean get_rate(GstStructure *s, gint *num, gint *den)
+{
+	*den = 1;
+	return gst_structure_get_int(s, "rate", num) || gst_structure_get_fraction(s, "rate", num, den);
+}
+
+
+static void reset(GstEASI *element, gint n)
+{
+	gint i, j;
+
+	element->n = n;
+	for(i = 0; i < 6; i++) {
+		for(j = 0; j < 6; j++)
+			element->unmix[i][j] = i == j;
+		element->mean[i] = 0.0;
+		element->variance[i] = 0.0;
+		element->kurtosis[i] = 0.0;
+	}
+	element->samples = 0;
+	element->have_previous = FALSE;
+}
+
+
+/*
+ * one EASI step.  z is the normalized input, y is set to the output
+ * before the update.
+ */
+
+
+static void easi_update(GstEASI *element, const gdouble *z, gdouble *y, gdouble mu, gdouble alpha)
+{
+	const gint n = element->n;
+	gdouble g[6], yb[6], gb[6];
+	gdouble yy = 0.0, yg = 0.0;
+	gdouble c1, c2;
+	gint i, j;
+
+	for(i = 0; i < n; i++) {
+		gdouble t;
+		y[i] = 0.0;
+		for(j = 0; j < n; j++)
+			y[i] += element->unmix[i][j] * z[j];
+		t = tanh(y[i]);
+		/* < 0 for sub-Gaussian components */
+		element->kurtosis[i] += alpha * (y[i] * t - (1.0 - t * t) - element->kurtosis[i]);
+		g[i] = element->kurtosis[i] > 0.0 ? -t : t;
+		yy += y[i] * y[i];
+		yg += y[i] * g[i];
+	}
+	c1 = 1.0 / (1.0 + mu * yy);
+	c2 = 1.0 / (1.0 + mu * fabs(yg));
+
+	for(j = 0; j < n; j++) {
+		yb[j] = gb[j] = 0.0;
+		for(i = 0; i < n; i++) {
+			yb[j] += y[i] * element->unmix[i][j];
+			gb[j] += g[i] * element->unmix[i][j];
+		}
+	}
+	for(i = 0; i < n; i++)
+		for(j = 0; j < n; j++)
+			element->unmix[i][j] -= mu * (c1 * (y[i] * yb[j] - element->unmix[i][j]) + c2 * (g[i] * yb[j] - y[i] * gb[j]));
+}
+
+
+/*
+ * put the components in canonical order and sign.  the colour
+ * coefficients are those of the un-normalized input, so the rules are
+ * applied to the unmixing matrix with the normalization folded in
+ */
+
+
+static void canonicalize(GstEASI *element)
+{
+	const gint n = element->n;
+	gdouble unmix[6][6], scaled[36];
+	gdouble kurtosis[6];
+	gint order[6];
+	gboolean negate[6];
+	gint k, j;
+
+	for(k = 0; k < n; k++)
+		for(j = 0; j < n; j++)
+			scaled[k * n + j] = element->unmix[k][j] / sqrt(element->variance[j]);
+	ica_canonical_order(scaled, n, order, negate);
+
+	memcpy(unmix, element->unmix, sizeof(unmix));
+	memcpy(kurtosis, element->kurtosis, sizeof(kurtosis));
+	for(k = 0; k < n; k++) {
+		for(j = 0; j < n; j++)
+			element->unmix[k][j] = negate[k] ? -unmix[order[k]][j] : unmix[order[k]][j];
+		element->kurtosis[k] = kurtosis[order[k]];
+	}
+}
+
+
+/*
+ * process one 6-channel sample in place
+ */
+
+
+static void process(GstEASI *element, gdouble *x, gboolean differentiate, gdouble mu, gdouble alpha)
+{
+	const gint n = element->n;
+	gdouble z[6], y[6], out[6];
+	gdouble a;
+	gint i, j;
+
+	if(differentiate) {
+		const gdouble rate = (gdouble) element->rate_num / element->rate_den;
+
+		if(!element->have_previous) {
+			/* no derivative for the first sample after a
+			 * discontinuity */
+			memcpy(element->previous, x, sizeof(element->previous));
+			memset(x, 0, sizeof(element->previous));
+			element->have_previous = TRUE;
+			return;
+		}
+		for(i = 0; i < 6; i++) {
+			const gdouble tmp = x[i];
+			x[i] = (x[i] - element->previous[i]) * rate;
+			element->previous[i] = tmp;
+		}
+	}
+
+	/* running averages.  until 1 / alpha samples have been seen
+	 * these are the plain averages of all samples so far */
+	element->samples++;
+	a = MAX(alpha, 1.0 / element->samples);
+	for(i = 0; i < 6; i++)
+		element->mean[i] += a * (x[i] - element->mean[i]);
+	for(i = 0; i < n; i++) {
+		z[i] = n == 6 ? x[i] - element->mean[i] : x[i] + x[3 + i] - element->mean[i] - element->mean[3 + i];
+		element->variance[i] += a * (z[i] * z[i] - element->variance[i]);
+	}
+	for(i = 0; i < n; i++) {
+		if(!(element->variance[i] > 0.0)) {
+			memset(x, 0, 6 * sizeof(*x));
+			return;
+		}
+		z[i] /= sqrt(element->variance[i]);
+	}
+
+	easi_update(element, z, y, mu, alpha);
+	canonicalize(element);
+
+	if(n == 6)
+		for(i = 0; i < 6; i++) {
+			out[i] = 0.0;
+			for(j = 0; j < 6; j++)
+				out[i] += element->unmix[i][j] * z[j];
+		}
+	else
+		for(i = 0; i < 3; i++) {
+			out[i] = out[3 + i] = 0.0;
+			for(j = 0; j < 3; j++) {
+				const gdouble w = element->unmix[i][j] / sqrt(element->variance[j]);
+				out[i] += w * (x[j] - element->mean[j]);
+				out[3 + i] += w * (x[3 + j] - element->mean[3 + j]);
+			}
+		}
+
+	for(i = 0; i < 6; i++)
+		if(!isfinite(out[i])) {
+			GST_WARNING_OBJECT(element, "unmixing matrix diverged, restarting adaptation.  step-size may be too large");
+			reset(element, n);
+			memset(x, 0, 6 * sizeof(*x));
+			return;
+		}
+	memcpy(x, out, sizeof(out));
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                          GstBaseTransform Methods
+ *
+ * ============================================================================
+ */
+
+
+static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps)
+{
+	GstEASI *element = GST_EASI(trans);
+	gint rate_num, rate_den;
+	gint n;
+
+	if(!get_rate(gst_caps_get_structure(incaps, 0), &rate_num, &rate_den) || rate_num <= 0) {
+		GST_ERROR_OBJECT(element, "failed to parse rate from incaps = %" GST_PTR_FORMAT, incaps);
+		return FALSE;
+	}
+
+	GST_OBJECT_LOCK(element);
+	n = element->joint ? 6 : 3;
+	GST_OBJECT_UNLOCK(element);
+
+	if(n != element->n)
+		reset(element, n);
+	element->rate_num = rate_num;
+	element->rate_den = rate_den;
+
+	GST_DEBUG_OBJECT(element, "%d/%d Hz:  %dx%d unmixing matrix", rate_num, rate_den, n, n);
+
+	return TRUE;
+}
+
+
+static gboolean start(GstBaseTransform *trans)
+{
+	GstEASI *element = GST_EASI(trans);
+
+	reset(element, element->n);
+
+	return TRUE;
+}
+
+
+static gboolean sink_event(GstBaseTransform *trans, GstEvent *event)
+{
+	GstEASI *element = GST_EASI(trans);
+
+	switch(GST_EVENT_TYPE(event)) {
+	case GST_EVENT_FLUSH_STOP:
+		reset(element, element->n);
+		break;
+
+	default:
+		break;
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(gst_easi_parent_class)->sink_event(trans, event);
+}
+
+
+static GstFlowReturn transform_ip(GstBaseTransform *trans, GstBuffer *buf)
+{
+	GstEASI *element = GST_EASI(trans);
+	gboolean differentiate;
+	gdouble mu, alpha;
+	GstMapInfo map;
+	gdouble *x;
+	guint64 n, k;
+
+	GST_OBJECT_LOCK(element);
+	differentiate = element->differentiate;
+	mu = element->step_size;
+	alpha = element->averaging_time ? MIN((gdouble) GST_SECOND * element->rate_den / element->rate_num / element->averaging_time, 1.0) : 1.0;
+	GST_OBJECT_UNLOCK(element);
+
+	if(GST_BUFFER_IS_DISCONT(buf)) {
+		GST_DEBUG_OBJECT(element, "discontinuity at %" GST_TIME_FORMAT, GST_TIME_ARGS(GST_BUFFER_PTS(buf)));
+		element->have_previous = FALSE;
+	}
+
+	if(!gst_buffer_map(buf, &map, GST_MAP_READWRITE)) {
+		GST_ELEMENT_ERROR(element, RESOURCE, FAILED, (NULL), ("failed to map buffer"));
+		return GST_FLOW_ERROR;
+	}
+	x = (gdouble *) map.data;
+	n = map.size / (6 * sizeof(*x));
+	for(k = 0; k < n; k++, x += 6)
+		process(element, x, differentiate, mu, alpha);
+	gst_buffer_unmap(buf, &map);
+
+	return GST_FLOW_OK;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                              GObject Methods
+ *
+ * ============================================================================
+ */
+
+
+enum property {
+	ARG_STEP_SIZE = 1,
+	ARG_AVERAGING_TIME,
+	ARG_JOINT,
+	ARG_DIFFERENTIATE,
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstEASI *element = GST_EASI(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_STEP_SIZE:
+		element->step_size = g_value_get_double(value);
+		break;
+
+	case ARG_AVERAGING_TIME:
+		element->averaging_time = g_value_get_uint64(value);
+		break;
+
+	case ARG_JOINT:
+		element->joint = g_value_get_boolean(value);
+		break;
+
+	case ARG_DIFFERENTIATE:
+		element->differentiate = g_value_get_boolean(value);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstEASI *element = GST_EASI(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_STEP_SIZE:
+		g_value_set_double(value, element->step_size);
+		break;
+
+	case ARG_AVERAGING_TIME:
+		g_value_set_uint64(value, element->averaging_time);
+		break;
+
+	case ARG_JOINT:
+		g_value_set_boolean(value, element->joint);
+		break;
+
+	case ARG_DIFFERENTIATE:
+		g_value_set_boolean(value, element->differentiate);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+#define CAPS \
+	"audio/x-raw, " \
+		"format = (string) " GST_AUDIO_NE(F64) ", " \
+		"channels = (int) 6, " \
+		"rate = (int) [1, MAX], " \
+		"layout = (string) interleaved; " \
+	"audio/x-raw, " \
+		"format = (string) " GST_AUDIO_NE(F64) ", " \
+		"channels = (int) 6, " \
+		"rate = (fraction) [0/1, MAX], " \
+		"layout = (string) interleaved"
+
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SINK_NAME,
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(CAPS)
+);
+
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SRC_NAME,
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(CAPS)
+);
+
+
+static void gst_easi_class_init(GstEASIClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->set_property = GST_DEBUG_FUNCPTR(set_property);
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
+
+	transform_class->set_caps = GST_DEBUG_FUNCPTR(set_caps);
+	transform_class->start = GST_DEBUG_FUNCPTR(start);
+	transform_class->sink_event = GST_DEBUG_FUNCPTR(sink_event);
+	transform_class->transform_ip = GST_DEBUG_FUNCPTR(transform_ip);
+	/* faceprocessor switches unmixing off with passthrough */
+	transform_class->transform_ip_on_passthrough = FALSE;
+
+	gst_element_class_set_details_simple(element_class,
+		"EASI RGB unmixer",
+		"Filter/Audio",
+		"Unmixes forehead and cheek R, G, B time series into independent components with an unmixing matrix adapted at each sample",
+		"Kipp Cannon <kipp.cannon@ligo.org>"
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_STEP_SIZE,
+		g_param_spec_double(
+			"step-size",
+			"Step size",
+			"Adaptation step size per sample.  The unmixing matrix adapts on a time scale of roughly 1 / (step-size * sample rate).  Larger values track changes faster but leave more noise in the matrix.",
+			0.0, 1.0, DEFAULT_STEP_SIZE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_AVERAGING_TIME,
+		g_param_spec_uint64(
+			"averaging-time",
+			"Averaging time",
+			"Time constant of the running averages used to normalize the input and to classify each component as sub- or super-Gaussian (ns).",
+			0, G_MAXUINT64, DEFAULT_AVERAGING_TIME,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_JOINT,
+		g_param_spec_boolean(
+			"joint",
+			"Joint",
+			"Adapt a 6x6 unmixing matrix to the forehead and cheek channels jointly, instead of a 3x3 matrix adapted to their sum and applied to each.  Takes effect at the next caps negotiation.",
+			DEFAULT_JOINT,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_DIFFERENTIATE,
+		g_param_spec_boolean(
+			"differentiate",
+			"Differentiate",
+			"Replace the input with its first derivative before unmixing, as rgb2ica.py does, to whiten the background noise spectrum.",
+			DEFAULT_DIFFERENTIATE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
+}
+
+
+static void gst_easi_init(GstEASI *element)
+{
+	element->rate_num = 0;
+	element->rate_den = 1;
+	reset(element, 3);
+}
@@ -0,0 +1,126 @@
+/*
+ * GstEASI
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __EASI_H__
+#define __EASI_H__
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+
+G_BEGIN_DECLS
+
+
+/*
+ * ============================================================================
+ *
+ *                                    Type
+ *
+ * ============================================================================
+ */
+
+
+#define GST_TYPE_EASI \
+	(gst_easi_get_type())
+#define GST_EASI(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_EASI, GstEASI))
+#define GST_EASI_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_EASI, GstEASIClass))
+#define GST_EASI_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_EASI, GstEASIClass))
+#define GST_IS_EASI(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_EASI))
+#define GST_IS_EASI_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_EASI))
+
+
+typedef struct _GstEASIClass GstEASIClass;
+typedef struct _GstEASI GstEASI;
+
+
+struct _GstEASIClass {
+	GstBaseTransformClass parent_class;
+};
+
+
+/**
+ * GstEASI
+ */
+
+
+struct _GstEASI {
+	GstBaseTransform basetransform;
+
+	gdouble step_size;
+	GstClockTime averaging_time;
+	gboolean joint;
+	gboolean differentiate;
+
+	/*
+	 * negotiated format
+	 */
+
+	gint rate_num, rate_den;
+
+	/*
+	 * stream state.  the unmixing matrix acts on the normalized
+	 * input, of which there are n channels:  the 6 input channels if
+	 * joint, otherwise the 3 channels of the forehead + cheek sum
+	 */
+
+	gint n;
+	gdouble unmix[6][6];
+	gdouble mean[6];	/* of each input channel */
+	gdouble variance[6];	/* of each normalized channel */
+	gdouble kurtosis[6];	/* of each component, sign selects nonlinearity */
+	guint64 samples;	/* since reset */
+	gdouble previous[6];
+	gboolean have_previous;
+};
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+GType gst_easi_get_type(void);
+
+
+G_END_DECLS
+
+
+#endif	/* __EASI_H__ */
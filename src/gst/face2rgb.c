@@ -75,7 +75,10 @@
  */
 
 
+#include <errno.h>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 
 #include <glib.h>
@@ -105,6 +108,31 @@
 #define DEFAULT_EYES_Y 0
 #define DEFAULT_EYES_WIDTH 0
 #define DEFAULT_EYES_HEIGHT 0
+#define DEFAULT_TILE_LOCATION NULL
+#define DEFAULT_TILE_SIZE 8
+
+
+/*
+ * tile summary file.  a header giving the frame and tile geometry and the
+ * pixel count of each tile, followed by one fixed-size record per frame:
+ *
+ *	guint64 timestamp (ns)
+ *	gdouble gamma
+ *	gint32 face, nose and eyes x, y, width, height (12 values)
+ *	gdouble gamma-corrected R, G, B sums for each tile in row-major order
+ *
+ * all in host byte order.  see tilecache.py.
+ *
+ * the file is opened when the element is first started and kept open
+ * until it is destroyed, so that a face processor that is shut down and
+ * restarted, e.g., when gst-cardiac recycles it for another face,
+ * appends to it rather than truncating it.  the frame size must not
+ * change for the life of the file.
+ */
+
+
+#define TILE_FILE_MAGIC "CARDTILE"
+#define TILE_FILE_VERSION 1
 
 
 enum mask_t {
@@ -202,6 +230,117 @@ static void make_mask(GstFace2RGB *element)
 }
 
 
+/*
+ * per-tile sums output
+ */
+
+
+static gboolean write_tile_header(GstFace2RGB *element)
+{
+	const gint ntiles = element->tiles_x * element->tiles_y;
+	guint32 header[] = {
+		TILE_FILE_VERSION,
+		element->width,
+		element->height,
+		element->tile_size,
+		element->tiles_x,
+		element->tiles_y
+	};
+	guint32 *counts = g_new(guint32, ntiles);
+	gint x, y;
+	gboolean success = TRUE;
+
+	for(y = 0; y < element->tiles_y; y++)
+		for(x = 0; x < element->tiles_x; x++)
+			counts[y * element->tiles_x + x] = MIN(element->tile_size, element->width - x * element->tile_size) * MIN(element->tile_size, element->height - y * element->tile_size);
+
+	success &= fwrite(TILE_FILE_MAGIC, 1, strlen(TILE_FILE_MAGIC), element->tile_file) == strlen(TILE_FILE_MAGIC);
+	success &= fwrite(header, sizeof(*header), G_N_ELEMENTS(header), element->tile_file) == G_N_ELEMENTS(header);
+	success &= fwrite(counts, sizeof(*counts), ntiles, element->tile_file) == (size_t) ntiles;
+
+	g_free(counts);
+	return success;
+}
+
+
+static gboolean write_tile_record(GstFace2RGB *element, GstClockTime timestamp)
+{
+	const size_t n = 3 * element->tiles_x * element->tiles_y;
+	guint64 t = timestamp;
+	gdouble gamma = element->gamma;
+	gint32 geometry[] = {
+		element->face_x, element->face_y, element->face_width, element->face_height,
+		element->nose_x, element->nose_y, element->nose_width, element->nose_height,
+		element->eyes_x, element->eyes_y, element->eyes_width, element->eyes_height
+	};
+	gboolean success = TRUE;
+
+	success &= fwrite(&t, sizeof(t), 1, element->tile_file) == 1;
+	success &= fwrite(&gamma, sizeof(gamma), 1, element->tile_file) == 1;
+	success &= fwrite(geometry, sizeof(*geometry), G_N_ELEMENTS(geometry), element->tile_file) == G_N_ELEMENTS(geometry);
+	success &= fwrite(element->tiles, sizeof(*element->tiles), n, element->tile_file) == n;
+
+	return success;
+}
+
+
+/*
+ * histogram output.  the sums of the gamma-corrected pixel values can be
+ * computed exactly from the histograms downstream for any gamma (see
+ * histogram2rgb), and the pixel counts give the region areas.
+ */
+
+
+static void accumulate_histograms(GstFace2RGB *element, GstBuffer *inbuf, GstBuffer *outbuf)
+{
+	const gint tile_size = element->tile_size;
+	gdouble *tiles = element->tile_file ? element->tiles : NULL;
+	gfloat gamma_table[FACE_2_RGB_HISTOGRAM_BINS];
+	GstMapInfo srcmap, dstmap;
+	guint32 *hist;
+	gint *mask = element->mask;
+	guchar *row, *last_row;
+	gint y;
+
+	if(tiles) {
+		gint i;
+		for(i = 0; i < FACE_2_RGB_HISTOGRAM_BINS; i++)
+			gamma_table[i] = powf(i, element->gamma);
+		memset(tiles, 0, 3 * element->tiles_x * element->tiles_y * sizeof(*tiles));
+	}
+
+	gst_buffer_map(outbuf, &dstmap, GST_MAP_WRITE);
+	hist = (guint32 *) dstmap.data;
+	memset(hist, 0, FACE_2_RGB_HISTOGRAM_CHANNELS * sizeof(*hist));
+
+	gst_buffer_map(inbuf, &srcmap, GST_MAP_READ);
+	row = (guchar *) srcmap.data;
+	last_row = row + element->height * element->stride;
+	for(y = 0; row < last_row; row += element->stride, y++) {
+		guchar *in = row;
+		guchar *last_col = in + 3 * element->width;
+		gdouble *tile_row = tiles ? tiles + 3 * (y / tile_size) * element->tiles_x : NULL;
+		gint x;
+		for(x = 0; in < last_col; x++, in += 3, mask++) {
+			if(*mask != MASK_UNUSED) {
+				guint32 *h = hist + *mask * 3 * FACE_2_RGB_HISTOGRAM_BINS;
+				h[in[0]]++;
+				h[FACE_2_RGB_HISTOGRAM_BINS + in[1]]++;
+				h[2 * FACE_2_RGB_HISTOGRAM_BINS + in[2]]++;
+			}
+			if(tile_row) {
+				gdouble *tile = tile_row + 3 * (x / tile_size);
+				tile[0] += gamma_table[in[0]];
+				tile[1] += gamma_table[in[1]];
+				tile[2] += gamma_table[in[2]];
+			}
+		}
+	}
+	gst_buffer_unmap(inbuf, &srcmap);
+	gst_buffer_unmap(outbuf, &dstmap);
+}
+
+
 /*
  * fast approximate pow() function.  accurate to within +/- 8% in [0,256)
  * for p in [0, 2].
@@ -260,7 +399,10 @@ static gboolean get_unit_size(GstBaseTransform *trans, GstCaps *caps, gsize *siz
 	if(!g_strcmp0(gst_structure_get_name(str), "audio/x-raw")) {
 		/* can't use gst_audio_info_from_caps():  doesn't
 		 * understand non-integer sample rates */
-		*size = 6 * 8;	/* FIXME:  hard-coded to 6 double-precision channels */
+		gint channels;
+		success = gst_structure_get_int(str, "channels", &channels);
+		if(success)
+			*size = channels * (!g_strcmp0(gst_structure_get_string(str, "format"), GST_AUDIO_NE(U32)) ? sizeof(guint32) : sizeof(gdouble));
 	} else if(!g_strcmp0(gst_structure_get_name(str), "video/x-raw")) {
 		GstVideoInfo info;
 		success = gst_video_info_from_caps(&info, caps);
@@ -329,6 +471,28 @@ static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outc
 	} else
 		GST_ERROR_OBJECT(element, "could not parse caps");
 
+	element->histogram = !g_strcmp0(gst_structure_get_string(gst_caps_get_structure(outcaps, 0), "format"), GST_AUDIO_NE(U32));
+
+	if(success && element->tile_file) {
+		gint tiles_x = (element->width + element->tile_size - 1) / element->tile_size;
+		gint tiles_y = (element->height + element->tile_size - 1) / element->tile_size;
+
+		if(!element->tile_header_written) {
+			element->tiles_x = tiles_x;
+			element->tiles_y = tiles_y;
+			if(!write_tile_header(element)) {
+				GST_ELEMENT_ERROR(element, RESOURCE, WRITE, (NULL), ("%s: %s", element->tile_location, g_strerror(errno)));
+				success = FALSE;
+			}
+			element->tile_header_written = TRUE;
+		} else if(tiles_x != element->tiles_x || tiles_y != element->tiles_y) {
+			GST_ELEMENT_ERROR(element, CORE, NEGOTIATION, (NULL), ("frame size cannot change while writing tile sums to %s", element->tile_location));
+			success = FALSE;
+		}
+		if(success)
+			element->tiles = g_realloc_n(element->tiles, 3 * tiles_x * tiles_y, sizeof(*element->tiles));
+	}
+
 	return success;
 }
 
@@ -339,6 +503,38 @@ static gboolean start(GstBaseTransform *trans)
 
 	element->offset = 0;
 
+	/* once per element lifetime, see above */
+	if(element->tile_location && !element->tile_file) {
+		element->tile_file = fopen(element->tile_location, "wb");
+		if(!element->tile_file) {
+			GST_ELEMENT_ERROR(element, RESOURCE, OPEN_WRITE, (NULL), ("%s: %s", element->tile_location, g_strerror(errno)));
+			return FALSE;
+		}
+		element->tile_header_written = FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean stop(GstBaseTransform *trans)
+{
+	GstFace2RGB *element = GST_FACE_2_RGB(trans);
+
+	/* release the mask.  a new one is allocated when caps are next
+	 * set */
+	g_free(element->mask);
+	element->mask = NULL;
+	element->need_new_mask = TRUE;
+
+	/* the tile file is kept open, see above */
+	if(element->tile_file && fflush(element->tile_file)) {
+		GST_ELEMENT_ERROR(element, RESOURCE, WRITE, (NULL), ("%s: %s", element->tile_location, g_strerror(errno)));
+		return FALSE;
+	}
+	g_free(element->tiles);
+	element->tiles = NULL;
+
 	return TRUE;
 }
 
@@ -351,6 +547,9 @@ static GstFlowReturn transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuf
 	gdouble *out;
 	guchar *row, *last_row;
 	gint *mask;
+	gdouble *tiles = element->tile_file ? element->tiles : NULL;
+	const gint tile_size = element->tile_size;
+	gint y;
 	gdouble forehead_r = 0.0, cheek_r = 0.0, bg_r = 0.0;
 	gdouble forehead_g = 0.0, cheek_g = 0.0, bg_g = 0.0;
 	gdouble forehead_b = 0.0, cheek_b = 0.0, bg_b = 0.0;
@@ -363,18 +562,28 @@ static GstFlowReturn transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuf
 	mask = element->mask;
 	g_return_val_if_fail(mask != NULL, GST_FLOW_ERROR);
 
+	if(element->histogram) {
+		accumulate_histograms(element, inbuf, outbuf);
+		goto done;
+	}
+
 	/*
 	 * apply gamma correction, and sum forehead, cheek, and background
 	 * RGB components
 	 */
 
+	if(tiles)
+		memset(tiles, 0, 3 * element->tiles_x * element->tiles_y * sizeof(*tiles));
+
 	gst_buffer_map(inbuf, &srcmap, GST_MAP_READ);
 	row = (guchar *) srcmap.data;
 	last_row = row + element->height * element->stride;
-	for(; row < last_row; row += element->stride) {
+	for(y = 0; row < last_row; row += element->stride, y++) {
 		guchar *in = row;
 		guchar *last_col = in + 3 * element->width;
-		for(; in < last_col;) {
+		gdouble *tile_row = tiles ? tiles + 3 * (y / tile_size) * element->tiles_x : NULL;
+		gint x;
+		for(x = 0; in < last_col; x++) {
 			/* we don't need to scale these into the range [0,
 			 * 1] because the factor of 255 will appear (raised
 			 * to the power gamma) in both the face and
@@ -394,6 +603,12 @@ static GstFlowReturn transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuf
 				b = powf(b, gamma);
 #endif
 			}
+			if(tile_row) {
+				gdouble *tile = tile_row + 3 * (x / tile_size);
+				tile[0] += r;
+				tile[1] += g;
+				tile[2] += b;
+			}
 			switch((enum mask_t) *mask++) {
 			case MASK_BG:
 				bg_r += r;
@@ -440,6 +655,12 @@ static GstFlowReturn transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuf
 	out[5] = cheek_b * element->bg_over_cheek_area_ratio / bg_y;
 	gst_buffer_unmap(outbuf, &dstmap);
 
+done:
+	if(element->tile_file && !write_tile_record(element, GST_BUFFER_PTS(inbuf))) {
+		GST_ELEMENT_ERROR(element, RESOURCE, WRITE, (NULL), ("%s: %s", element->tile_location, g_strerror(errno)));
+		return GST_FLOW_ERROR;
+	}
+
 	/*
 	 * fix offset on output buffers
 	 */
@@ -479,6 +700,8 @@ enum property {
 	ARG_EYES_Y,
 	ARG_EYES_WIDTH,
 	ARG_EYES_HEIGHT,
+	ARG_TILE_LOCATION,
+	ARG_TILE_SIZE,
 };
 
 
@@ -553,6 +776,22 @@ static void set_property(GObject *object, enum property prop_id, const GValue *v
 		element->need_new_mask = TRUE;
 		break;
 
+	case ARG_TILE_LOCATION:
+		if(element->tile_file)
+			GST_WARNING_OBJECT(element, "cannot change tile-location once tile sums have been written");
+		else {
+			g_free(element->tile_location);
+			element->tile_location = g_value_dup_string(value);
+		}
+		break;
+
+	case ARG_TILE_SIZE:
+		if(element->tile_file)
+			GST_WARNING_OBJECT(element, "cannot change tile-size once tile sums have been written");
+		else
+			element->tile_size = g_value_get_int(value);
+		break;
+
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -621,6 +860,14 @@ static void get_property(GObject *object, enum property prop_id, GValue *value,
 		g_value_set_int(value, element->eyes_height);
 		break;
 
+	case ARG_TILE_LOCATION:
+		g_value_set_string(value, element->tile_location);
+		break;
+
+	case ARG_TILE_SIZE:
+		g_value_set_int(value, element->tile_size);
+		break;
+
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -636,6 +883,13 @@ static void finalize(GObject *object)
 
 	g_free(element->mask);
 	element->mask = NULL;
+	if(element->tile_file)
+		fclose(element->tile_file);
+	element->tile_file = NULL;
+	g_free(element->tile_location);
+	element->tile_location = NULL;
+	g_free(element->tiles);
+	element->tiles = NULL;
 
 	/*
 	 * chain to parent class' finalize() method
@@ -669,6 +923,12 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
 			"channels = (int) 6, " \
 			"rate = (fraction) [0/1, MAX], " \
 			"layout = (string) interleaved, " \
+			"channel-mask = (bitmask) 0; " \
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(U32) ", " \
+			"channels = (int) 2304, " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved, " \
 			"channel-mask = (bitmask) 0"
 	)
 );
@@ -688,12 +948,13 @@ static void gst_face_2_rgb_class_init(GstFace2RGBClass *klass)
 	transform_class->transform_caps = GST_DEBUG_FUNCPTR(transform_caps);
 	transform_class->set_caps = GST_DEBUG_FUNCPTR(set_caps);
 	transform_class->start = GST_DEBUG_FUNCPTR(start);
+	transform_class->stop = GST_DEBUG_FUNCPTR(stop);
 	transform_class->transform = GST_DEBUG_FUNCPTR(transform);
 
 	gst_element_class_set_details_simple(element_class, 
 		"Face to RGB time series",
 		"Filter/Video",
-		"Convert a video stream to forehead and cheek, red, green, blue time series triples",
+		"Convert a video stream to forehead and cheek, red, green, blue time series triples, or to per-region colour histograms from which they can be computed for any gamma",
 		"Kipp Cannon <kipp.cannon@ligo.org>"
 	);
 
@@ -853,6 +1114,30 @@ static void gst_face_2_rgb_class_init(GstFace2RGBClass *klass)
 		)
 	);
 
+	g_object_class_install_property(
+		gobject_class,
+		ARG_TILE_LOCATION,
+		g_param_spec_string(
+			"tile-location",
+			"Tile sums file",
+			"If set, write the gamma-corrected R, G, B sums of each tile-size x tile-size block of pixels in every frame, together with the face geometry, to this file.  Any region's time series can later be computed from the tile sums without decoding the video again.  The file is opened when the element is first started and written until the element is destroyed, so it survives the element being stopped and restarted;  the location cannot be changed after that.",
+			DEFAULT_TILE_LOCATION,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_TILE_SIZE,
+		g_param_spec_int(
+			"tile-size",
+			"Tile size",
+			"Width and height of the tiles written to tile-location.",
+			1, G_MAXINT, DEFAULT_TILE_SIZE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
 	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
 	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
 }
@@ -864,4 +1149,7 @@ static void gst_face_2_rgb_init(GstFace2RGB *element)
 
 	element->mask = NULL;
 	element->need_new_mask = TRUE;
+	element->tile_location = NULL;
+	element->tile_file = NULL;
+	element->tiles = NULL;
 }
@@ -32,6 +32,9 @@
  */
 
 
+#include <stdio.h>
+
+
 #include <glib.h>
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
@@ -63,6 +66,18 @@ G_BEGIN_DECLS
 	(G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_FACE_2_RGB))
 
 
+/*
+ * histogram output format:  for each of the background, forehead and
+ * cheek regions, in that order, 256-bin histograms of the red, green and
+ * blue 8-bit pixel values, in that order, as guint32 counts.
+ */
+
+
+#define FACE_2_RGB_HISTOGRAM_REGIONS 3
+#define FACE_2_RGB_HISTOGRAM_BINS 256
+#define FACE_2_RGB_HISTOGRAM_CHANNELS 2304	/* regions x 3 colours x bins */
+
+
 typedef struct _GstFace2RGBClass GstFace2RGBClass;
 typedef struct _GstFace2RGB GstFace2RGB;
 
@@ -91,10 +106,22 @@ struct _GstFace2RGB {
 
 	gint width, height;	/* pixels */
 	gint stride;	/* bytes */
+	gboolean histogram;
 	gint *mask;
 	gdouble bg_over_forehead_area_ratio;
 	gdouble bg_over_cheek_area_ratio;
 
+	/*
+	 * optional per-tile RGB sums
+	 */
+
+	gchar *tile_location;
+	gint tile_size;	/* pixels */
+	FILE *tile_file;
+	gboolean tile_header_written;
+	gint tiles_x, tiles_y;
+	gdouble *tiles;
+
 	guint64 offset;
 };
 
@@ -33,11 +33,20 @@
 
 #include <glib.h>
 #include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
 
 
 #include <faceprocessor.h>
 
 
+#define DEFAULT_ACTIVE TRUE
+#define DEFAULT_OUTPUT_RATE 30	/* Hz, used when the input frame rate is variable */
+#define DEFAULT_DECIMATION 1
+#define DEFAULT_UNMIX FALSE
+#define DEFAULT_ADAPTIVE FALSE
+#define DEFAULT_RATE 0	/* Hz, 0 = from the first input caps */
+
+
 /*
  * ============================================================================
  *
@@ -69,30 +78,67 @@ G_DEFINE_TYPE_WITH_CODE(GstFaceProcessor, gst_face_processor, GST_TYPE_BIN, addi
  */
 
 
+/*
+ * set the rate to which the RGB time series is resampled.  done once:
+ * irregularresample places the samples by their timestamps, so the
+ * output rate need not follow the frame rate, and renegotiating
+ * downstream would restart the band-pass filter
+ */
+
+
+static void set_output_rate(GstFaceProcessor *element, gint rate)
+{
+	GstCaps *caps = gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, rate, NULL);
+	g_object_set(G_OBJECT(element->capsfilter), "caps", caps, NULL);
+	gst_caps_unref(caps);
+}
+
+
 static void caps_notify_handler(GObject *object, GParamSpec *pspec, gpointer user_data)
 {
 	GstFaceProcessor *element = GST_FACE_PROCESSOR(gst_pad_get_parent(object));
 	GstCaps *caps;
 	GstStructure *s;
 	gint rate_num, rate_den;
-	gboolean success = TRUE;
+	gint decimation, rate;
+
+	GST_OBJECT_LOCK(element);
+	decimation = element->decimation;
+	rate = element->rate;
+	GST_OBJECT_UNLOCK(element);
 
 	caps = gst_pad_get_current_caps(GST_PAD(object));
 	if(!caps || !gst_caps_is_fixed(caps))
 		goto done;
 
-	s = gst_caps_get_structure(caps, 0);
-	success &= gst_structure_get_fraction(s, "framerate", &rate_num, &rate_den);
-
-	if(success) {
-		gint rate = ceil((double) rate_num / rate_den);
-
-		GST_DEBUG_OBJECT(element, "input caps = %" GST_PTR_FORMAT "; RGB time series will be resampled from %d/%d Hz to %d Hz", caps, rate_num, rate_den, rate);
+	if(rate) {
+		GST_DEBUG_OBJECT(element, "input caps = %" GST_PTR_FORMAT "; RGB time series rate remains %d Hz", caps, rate);
+		goto done;
+	}
 
-		/* FIXME:  does this leak memory? */
-		g_object_set(G_OBJECT(element->capsfilter), "caps", gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, rate, NULL), NULL);
-	} else
+	s = gst_caps_get_structure(caps, 0);
+	if(!gst_structure_get_fraction(s, "framerate", &rate_num, &rate_den)) {
 		GST_ERROR_OBJECT(element, "could not determine framerate from input caps %" GST_PTR_FORMAT, caps);
+		goto done;
+	}
+
+	rate = ceil((double) rate_num / rate_den);
+	if(rate <= 0) {
+		/* variable frame rate */
+		rate = DEFAULT_OUTPUT_RATE;
+		GST_WARNING_OBJECT(element, "input caps = %" GST_PTR_FORMAT " do not give a frame rate, assuming %d Hz", caps, rate);
+	}
+	/* resample to a multiple of the decimation factor so that the
+	 * decimated rate is a whole number of Hz */
+	rate = decimation * ((rate + decimation - 1) / decimation);
+
+	GST_OBJECT_LOCK(element);
+	element->rate = rate;
+	GST_OBJECT_UNLOCK(element);
+
+	GST_DEBUG_OBJECT(element, "input caps = %" GST_PTR_FORMAT "; RGB time series will be resampled from %d/%d Hz to %d Hz and decimated to %d Hz", caps, rate_num, rate_den, rate, rate / decimation);
+	set_output_rate(element, rate);
+	g_object_notify(G_OBJECT(element), "rate");
 
 done:
 	if(caps)
@@ -101,6 +147,36 @@ done:
 }
 
 
+/*
+ * drop video frames while the processor is idle.  only buffers are
+ * dropped, events (caps, segments, etc.) continue to flow so that the
+ * processor is fully negotiated and can be switched on without stalling
+ * the pipeline.  the first buffer after (re-)activation is marked as a
+ * discontinuity so that downstream elements resynchronize.
+ */
+
+
+static GstPadProbeReturn active_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	GstFaceProcessor *element = GST_FACE_PROCESSOR(user_data);
+	GstPadProbeReturn result = GST_PAD_PROBE_OK;
+
+	GST_OBJECT_LOCK(element);
+	if(!element->active) {
+		element->need_discont = TRUE;
+		result = GST_PAD_PROBE_DROP;
+	} else if(element->need_discont) {
+		GstBuffer *buf = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+		GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DISCONT);
+		GST_PAD_PROBE_INFO_DATA(info) = buf;
+		element->need_discont = FALSE;
+	}
+	GST_OBJECT_UNLOCK(element);
+
+	return result;
+}
+
+
 /*
  * ============================================================================
  *
@@ -110,6 +186,104 @@ done:
  */
 
 
+enum property {
+	ARG_ACTIVE = 1,
+	ARG_DECIMATION,
+	ARG_UNMIX,
+	ARG_ADAPTIVE,
+	ARG_RATE,
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstFaceProcessor *element = GST_FACE_PROCESSOR(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_ACTIVE:
+		element->active = g_value_get_boolean(value);
+		break;
+
+	case ARG_DECIMATION:
+		element->decimation = g_value_get_int(value);
+		break;
+
+	case ARG_UNMIX:
+		element->unmix = g_value_get_boolean(value);
+		break;
+
+	case ARG_ADAPTIVE:
+		element->adaptive = g_value_get_boolean(value);
+		break;
+
+	case ARG_RATE:
+		element->rate = g_value_get_int(value);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+
+	/* takes effect when the input caps are next set */
+	if(prop_id == ARG_DECIMATION)
+		g_object_set(G_OBJECT(element->decimate), "factor", g_value_get_int(value), NULL);
+	if(prop_id == ARG_RATE && g_value_get_int(value))
+		set_output_rate(element, g_value_get_int(value));
+	if(prop_id == ARG_UNMIX || prop_id == ARG_ADAPTIVE) {
+		gboolean unmix, adaptive;
+
+		GST_OBJECT_LOCK(element);
+		unmix = element->unmix;
+		adaptive = element->adaptive;
+		GST_OBJECT_UNLOCK(element);
+
+		gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(element->fastica), !(unmix && !adaptive));
+		gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(element->easi), !(unmix && adaptive));
+	}
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstFaceProcessor *element = GST_FACE_PROCESSOR(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_ACTIVE:
+		g_value_set_boolean(value, element->active);
+		break;
+
+	case ARG_DECIMATION:
+		g_value_set_int(value, element->decimation);
+		break;
+
+	case ARG_UNMIX:
+		g_value_set_boolean(value, element->unmix);
+		break;
+
+	case ARG_ADAPTIVE:
+		g_value_set_boolean(value, element->adaptive);
+		break;
+
+	case ARG_RATE:
+		g_value_set_int(value, element->rate);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
 static void finalize(GObject *object)
 {
 	GstFaceProcessor *element = GST_FACE_PROCESSOR(object);
@@ -118,6 +292,12 @@ static void finalize(GObject *object)
 	element->face2rgb = NULL;
 	gst_object_unref(element->capsfilter);
 	element->capsfilter = NULL;
+	gst_object_unref(element->decimate);
+	element->decimate = NULL;
+	gst_object_unref(element->fastica);
+	element->fastica = NULL;
+	gst_object_unref(element->easi);
+	element->easi = NULL;
 
 	G_OBJECT_CLASS(gst_face_processor_parent_class)->finalize(object);
 }
@@ -128,6 +308,8 @@ static void gst_face_processor_class_init(GstFaceProcessorClass *klass)
 	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
 	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
 
+	gobject_class->set_property = GST_DEBUG_FUNCPTR(set_property);
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
 	gobject_class->finalize = GST_DEBUG_FUNCPTR(finalize);
 
 	gst_element_class_set_details_simple(element_class,
@@ -136,6 +318,66 @@ static void gst_face_processor_class_init(GstFaceProcessorClass *klass)
 		"Cardiac pulse extractor",
 		"Kipp Cannon <kipp.cannon@ligo.org>"
 	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_ACTIVE,
+		g_param_spec_boolean(
+			"active",
+			"Active",
+			"Process video frames.  When FALSE the processor remains linked and negotiated but discards its input, allowing a pool of idle processors to be built in advance and switched on without pausing the pipeline.",
+			DEFAULT_ACTIVE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_DECIMATION,
+		g_param_spec_int(
+			"decimation",
+			"Decimation",
+			"Reduce the sample rate of the RGB time series by this factor before band-pass filtering.  Unless rate is set, the time series is resampled to the smallest multiple of this factor not less than the frame rate.  The band-pass filter's upper edge is 5 Hz, so the decimated rate should remain above 10 Hz.",
+			1, G_MAXINT, DEFAULT_DECIMATION,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_UNMIX,
+		g_param_spec_boolean(
+			"unmix",
+			"Unmix",
+			"Differentiate the decimated RGB time series and unmix them into independent components before band-pass filtering, with a sliding-window FastICA or, see adaptive, with EASI.  The fastica element's properties are reachable as fastica::property-name.",
+			DEFAULT_UNMIX,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_ADAPTIVE,
+		g_param_spec_boolean(
+			"adaptive",
+			"Adaptive",
+			"When unmixing, adapt the unmixing matrix at every sample with EASI instead of recomputing it from a sliding window with FastICA.  Memory and CPU cost per sample are constant.  The easi element's properties are reachable as easi::property-name.",
+			DEFAULT_ADAPTIVE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_RATE,
+		g_param_spec_int(
+			"rate",
+			"Rate",
+			"Sample rate to which the RGB time series is resampled before decimation (Hz).  Should be a multiple of decimation.  If 0, it is chosen from the frame rate in the first input caps.  Once chosen it does not change, even if the frame rate does:  samples are placed by their timestamps, and changing it would restart the band-pass filter.",
+			0, G_MAXINT, DEFAULT_RATE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT | GST_PARAM_MUTABLE_READY
+		)
+	);
 }
 
 
@@ -151,16 +393,30 @@ static void gst_face_processor_init(GstFaceProcessor *faceprocessor)
 	gst_object_ref(faceprocessor->face2rgb);	/* now two refs */
 	faceprocessor->capsfilter = gst_element_factory_make("capsfilter", "capsfilter"),
 	gst_object_ref(faceprocessor->capsfilter);	/* now two refs */
+	faceprocessor->decimate = gst_element_factory_make("audiodecimate", "audiodecimate"),
+	gst_object_ref(faceprocessor->decimate);	/* now two refs */
+	faceprocessor->fastica = gst_element_factory_make("fastica", "fastica"),
+	gst_object_ref(faceprocessor->fastica);	/* now two refs */
+	faceprocessor->easi = gst_element_factory_make("easi", "easi"),
+	gst_object_ref(faceprocessor->easi);	/* now two refs */
 	gst_bin_add_many(bin,
 		faceprocessor->face2rgb,	/* consume one ref */
-		resample = gst_element_factory_make("audiorationalresample", "audiorationalresample"),
+		resample = gst_element_factory_make("irregularresample", "irregularresample"),
 		faceprocessor->capsfilter,
+		faceprocessor->decimate,
+		faceprocessor->fastica,
+		faceprocessor->easi,
 		bandpass = gst_element_factory_make("audiochebband", "audiochebband"),
 		tsvenc = gst_element_factory_make("tsvenc", "tsvenc"),
 		sink = gst_element_factory_make("fdsink", "sink"),
 		NULL
 	);
 
+	faceprocessor->need_discont = FALSE;
+	pad = gst_element_get_static_pad(faceprocessor->face2rgb, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, active_probe, faceprocessor, NULL);
+	gst_object_unref(pad);
+
 	pad = gst_ghost_pad_new("sink", gst_element_get_static_pad(faceprocessor->face2rgb, "sink"));
 	g_signal_connect_after(pad, "notify::caps", (GCallback) caps_notify_handler, NULL);
 	gst_element_add_pad(element, pad);
@@ -168,5 +424,5 @@ static void gst_face_processor_init(GstFaceProcessor *faceprocessor)
 	g_object_set(G_OBJECT(bandpass), "lower-frequency", 0.5, "upper-frequency", 5.0, "poles", 4, NULL);
 	g_object_set(G_OBJECT(sink), "fd", 1, "sync", FALSE, "async", FALSE, NULL);
 
-	gst_element_link_many(faceprocessor->face2rgb, resample, faceprocessor->capsfilter, bandpass, tsvenc, sink, NULL);
+	gst_element_link_many(faceprocessor->face2rgb, resample, faceprocessor->capsfilter, faceprocessor->decimate, faceprocessor->fastica, faceprocessor->easi, bandpass, tsvenc, sink, NULL);
 }
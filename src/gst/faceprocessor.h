@@ -81,6 +81,16 @@ struct _GstFaceProcessor {
 
 	GstElement *face2rgb;
 	GstElement *capsfilter;
+	GstElement *decimate;
+	GstElement *fastica;
+	GstElement *easi;
+
+	gboolean active;
+	gint decimation;
+	gboolean unmix;
+	gboolean adaptive;
+	gint rate;	/* resampled RGB time series, 0 until chosen */
+	gboolean need_discont;
 };
 
 
@@ -0,0 +1,657 @@
+/*
+ * GstFastICA
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * unmixes face2rgb's forehead and cheek R, G, B time series into
+ * independent components, the streaming equivalent of rgb2ica.py.  the
+ * input is differentiated to whiten the background noise spectrum.  the
+ * most recent window of samples is kept, and at intervals the forehead
+ * and cheek streams in it are summed, whitened, and FastICA run on the
+ * result to find a 3x3 unmixing matrix which is then applied to the
+ * forehead and cheek streams separately, giving 6 output channels in the
+ * same layout as the input.  the order and signs of the components are
+ * fixed with the rules used by rgb2ica.py so that channel meaning doesn't
+ * change from one update to the next.
+ *
+ * consecutive windows overlap almost entirely, so each update is started
+ * from the previous unmixing matrix and converges in a few iterations.
+ * the whitening uses the symmetric inverse square root of the covariance
+ * rather than a PCA projection:  it varies smoothly as the window slides,
+ * where the order and signs of the principal axes would not, so the
+ * previous matrix expressed in the new whitened basis remains a good
+ * starting point.
+ *
+ * the derivative is the backward difference, so the output lags the
+ * input by half a sample.  until the window is half full there is no
+ * unmixing matrix and the output is silence flagged as a gap.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <string.h>
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+#include <gst/base/gstbasetransform.h>
+
+
+#include <fastica.h>
+#include <ica.h>
+
+
+#define DEFAULT_WINDOW (30 * GST_SECOND)
+#define DEFAULT_UPDATE_INTERVAL GST_SECOND
+#define DEFAULT_MAX_ITERATIONS 20
+#define DEFAULT_TOLERANCE 1e-8
+#define DEFAULT_DIFFERENTIATE TRUE
+
+
+/*
+ * ============================================================================
+ *
+ *                                Boilerplate
+ *
+ * ============================================================================
+ */
+
+
+#define GST_CAT_DEFAULT gst_fastica_debug
+GST_DEBUG_CATEGORY_STATIC(GST_CAT_DEFAULT);
+
+
+static void additional_initializations(void)
+{
+	GST_DEBUG_CATEGORY_INIT(GST_CAT_DEFAULT, "fastica", 0, "fastica element");
+}
+
+
+G_DEFINE_TYPE_WITH_CODE(GstFastICA, gst_fastica, GST_TYPE_BASE_TRANSFORM, additional_initializations(););
+
+
+/*
+ * ============================================================================
+ *
+ *                             Internal Functions
+ *
+ * ============================================================================
+ */
+
+
+static gboolean get_rate(GstStructure *s, gint *num, gint *den)
+{
+	*den = 1;
+	return gst_structure_get_int(s, "rate", num) || gst_structure_get_fraction(s, "rate", num, den);
+}
+
+
+static void reset(GstFastICA *element)
+{
+	element->history_length = 0;
+	element->history_next = 0;
+	element->have_previous = FALSE;
+	element->since_update = 0;
+	element->have_unmix = FALSE;
+}
+
+
+/*
+ * change the length of the window, keeping as many of the most recent
+ * samples as fit.  they are copied oldest first, so the window is again
+ * used from 0 to history_length
+ */
+
+
+static void resize_window(GstFastICA *element, guint64 window_length)
+{
+	const guint64 keep = MIN(element->history_length, window_length);
+	gdouble *history = g_new(gdouble, 6 * window_length);
+	guint64 k;
+
+	for(k = 0; k < keep; k++) {
+		const guint64 j = (element->history_next + element->window_length - keep + k) % element->window_length;
+		memcpy(history + 6 * k, element->history + 6 * j, 6 * sizeof(*history));
+	}
+	g_free(element->history);
+	element->history = history;
+	element->whitened = g_renew(gdouble, element->whitened, 3 * window_length);
+	element->window_length = window_length;
+	element->history_length = keep;
+	element->history_next = keep % window_length;
+}
+
+
+/*
+ * recompute the unmixing matrix from the samples in the window
+ */
+
+
+static void update(GstFastICA *element, gint max_iterations, gdouble tolerance)
+{
+	const guint64 n = element->history_length;
+	gdouble mean[6] = {0.0};
+	gdouble covariance[3][3] = {{0.0}};
+	gdouble root[3][3], whiten[3][3];
+	gdouble w[3][3];
+	gint iterations;
+	guint64 k;
+	gint i, j;
+
+	for(k = 0; k < n; k++)
+		for(i = 0; i < 6; i++)
+			mean[i] += element->history[6 * k + i];
+	for(i = 0; i < 6; i++)
+		mean[i] /= n;
+
+	/* the sum of the forehead and cheek streams has the better SNR */
+	for(k = 0; k < n; k++) {
+		const gdouble *x = element->history + 6 * k;
+		gdouble s[3];
+		for(i = 0; i < 3; i++)
+			s[i] = x[i] + x[3 + i] - mean[i] - mean[3 + i];
+		for(i = 0; i < 3; i++)
+			for(j = 0; j <= i; j++)
+				covariance[i][j] += s[i] * s[j];
+	}
+	for(i = 0; i < 3; i++)
+		for(j = 0; j <= i; j++)
+			covariance[i][j] = covariance[j][i] = covariance[i][j] / n;
+
+	if(!ica_sym3_sqrt(covariance, root, whiten)) {
+		GST_DEBUG_OBJECT(element, "covariance is singular, unmixing matrix not updated");
+		return;
+	}
+	for(k = 0; k < n; k++) {
+		const gdouble *x = element->history + 6 * k;
+		gdouble *z = element->whitened + 3 * k;
+		gdouble s[3];
+		for(i = 0; i < 3; i++)
+			s[i] = x[i] + x[3 + i] - mean[i] - mean[3 + i];
+		for(i = 0; i < 3; i++)
+			z[i] = whiten[i][0] * s[0] + whiten[i][1] * s[1] + whiten[i][2] * s[2];
+	}
+
+	/* start from the previous unmixing matrix, expressed in the new
+	 * whitened basis */
+	if(element->have_unmix)
+		ica_mat3_mul(element->unmix, root, w);
+	else
+		for(i = 0; i < 3; i++)
+			for(j = 0; j < 3; j++)
+				w[i][j] = i == j;
+
+	iterations = ica_fastica_exp(element->whitened, n, w, max_iterations, tolerance);
+	if(iterations < 0) {
+		GST_DEBUG_OBJECT(element, "FastICA failed, unmixing matrix not updated");
+		return;
+	}
+
+	ica_mat3_mul(w, whiten, element->unmix);
+	ica_canonicalize(element->unmix);
+	memcpy(element->mean, mean, sizeof(mean));
+	element->have_unmix = TRUE;
+
+	GST_OBJECT_LOCK(element);
+	element->iterations = iterations;
+	GST_OBJECT_UNLOCK(element);
+
+	GST_LOG_OBJECT(element, "%d iteration(s), unmix = [[%g, %g, %g], [%g, %g, %g], [%g, %g, %g]]", iterations, element->unmix[0][0], element->unmix[0][1], element->unmix[0][2], element->unmix[1][0], element->unmix[1][1], element->unmix[1][2], element->unmix[2][0], element->unmix[2][1], element->unmix[2][2]);
+}
+
+
+/*
+ * replace one 6-channel sample with its derivative (if enabled) and add
+ * it to the window.  the first sample after a discontinuity has no
+ * derivative:  it is zeroed, not added, and FALSE is returned.
+ */
+
+
+static gboolean add_sample(GstFastICA *element, gdouble *x, gboolean differentiate)
+{
+	gint i;
+
+	if(differentiate) {
+		const gdouble rate = (gdouble) element->rate_num / element->rate_den;
+
+		if(!element->have_previous) {
+			memcpy(element->previous, x, sizeof(element->previous));
+			memset(x, 0, sizeof(element->previous));
+			element->have_previous = TRUE;
+			return FALSE;
+		}
+		for(i = 0; i < 6; i++) {
+			const gdouble tmp = x[i];
+			x[i] = (x[i] - element->previous[i]) * rate;
+			element->previous[i] = tmp;
+		}
+	}
+
+	memcpy(element->history + 6 * element->history_next, x, 6 * sizeof(*x));
+	element->history_next = (element->history_next + 1) % element->window_length;
+	element->history_length = MIN(element->history_length + 1, element->window_length);
+	element->since_update++;
+
+	return TRUE;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                          GstBaseTransform Methods
+ *
+ * ============================================================================
+ */
+
+
+static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps)
+{
+	GstFastICA *element = GST_FASTICA(trans);
+	GstClockTime window, update_interval;
+	guint64 window_length;
+	gint rate_num, rate_den;
+
+	if(!get_rate(gst_caps_get_structure(incaps, 0), &rate_num, &rate_den) || rate_num <= 0) {
+		GST_ERROR_OBJECT(element, "failed to parse rate from incaps = %" GST_PTR_FORMAT, incaps);
+		return FALSE;
+	}
+
+	GST_OBJECT_LOCK(element);
+	window = element->window;
+	update_interval = element->update_interval;
+	GST_OBJECT_UNLOCK(element);
+
+	/* a change of rate mid-stream keeps the window's contents.  the
+	 * derivatives are per unit time, so samples at either rate can
+	 * share it */
+	window_length = MAX(gst_util_uint64_scale_ceil(window, rate_num, (guint64) GST_SECOND * rate_den), 2);
+	if(window_length != element->window_length)
+		resize_window(element, window_length);
+	element->rate_num = rate_num;
+	element->rate_den = rate_den;
+	element->stride = MAX(gst_util_uint64_scale_round(update_interval, rate_num, (guint64) GST_SECOND * rate_den), 1);
+
+	GST_DEBUG_OBJECT(element, "%d/%d Hz:  window is %" G_GUINT64_FORMAT " samples, updated every %" G_GUINT64_FORMAT " samples", rate_num, rate_den, element->window_length, element->stride);
+
+	return TRUE;
+}
+
+
+static gboolean start(GstBaseTransform *trans)
+{
+	reset(GST_FASTICA(trans));
+
+	return TRUE;
+}
+
+
+static gboolean stop(GstBaseTransform *trans)
+{
+	GstFastICA *element = GST_FASTICA(trans);
+
+	g_free(element->history);
+	element->history = NULL;
+	g_free(element->whitened);
+	element->whitened = NULL;
+	element->window_length = 0;
+	reset(element);
+
+	return TRUE;
+}
+
+
+static gboolean sink_event(GstBaseTransform *trans, GstEvent *event)
+{
+	GstFastICA *element = GST_FASTICA(trans);
+
+	switch(GST_EVENT_TYPE(event)) {
+	case GST_EVENT_FLUSH_STOP:
+		reset(element);
+		break;
+
+	default:
+		break;
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(gst_fastica_parent_class)->sink_event(trans, event);
+}
+
+
+static GstFlowReturn transform_ip(GstBaseTransform *trans, GstBuffer *buf)
+{
+	GstFastICA *element = GST_FASTICA(trans);
+	gboolean differentiate;
+	gint max_iterations;
+	gdouble tolerance;
+	gboolean gap = TRUE;
+	GstMapInfo map;
+	gdouble *x;
+	guint64 n, k;
+
+	GST_OBJECT_LOCK(element);
+	differentiate = element->differentiate;
+	max_iterations = element->max_iterations;
+	tolerance = element->tolerance;
+	GST_OBJECT_UNLOCK(element);
+
+	if(GST_BUFFER_IS_DISCONT(buf)) {
+		GST_DEBUG_OBJECT(element, "discontinuity at %" GST_TIME_FORMAT, GST_TIME_ARGS(GST_BUFFER_PTS(buf)));
+		element->have_previous = FALSE;
+	}
+
+	if(!gst_buffer_map(buf, &map, GST_MAP_READWRITE)) {
+		GST_ELEMENT_ERROR(element, RESOURCE, FAILED, (NULL), ("failed to map buffer"));
+		return GST_FLOW_ERROR;
+	}
+	x = (gdouble *) map.data;
+	n = map.size / (6 * sizeof(*x));
+	for(k = 0; k < n; k++, x += 6) {
+		gdouble y[6];
+		gint i;
+
+		if(add_sample(element, x, differentiate) && element->since_update >= element->stride && 2 * element->history_length >= element->window_length) {
+			update(element, max_iterations, tolerance);
+			element->since_update = 0;
+		}
+
+		if(!element->have_unmix) {
+			memset(x, 0, 6 * sizeof(*x));
+			continue;
+		}
+		for(i = 0; i < 3; i++) {
+			y[i] = element->unmix[i][0] * (x[0] - element->mean[0]) + element->unmix[i][1] * (x[1] - element->mean[1]) + element->unmix[i][2] * (x[2] - element->mean[2]);
+			y[3 + i] = element->unmix[i][0] * (x[3] - element->mean[3]) + element->unmix[i][1] * (x[4] - element->mean[4]) + element->unmix[i][2] * (x[5] - element->mean[5]);
+		}
+		memcpy(x, y, sizeof(y));
+		gap = FALSE;
+	}
+	gst_buffer_unmap(buf, &map);
+
+	if(gap && n)
+		GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_GAP);
+
+	return GST_FLOW_OK;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                              GObject Methods
+ *
+ * ============================================================================
+ */
+
+
+enum property {
+	ARG_WINDOW = 1,
+	ARG_UPDATE_INTERVAL,
+	ARG_MAX_ITERATIONS,
+	ARG_TOLERANCE,
+	ARG_DIFFERENTIATE,
+	ARG_ITERATIONS,
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstFastICA *element = GST_FASTICA(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_WINDOW:
+		element->window = g_value_get_uint64(value);
+		break;
+
+	case ARG_UPDATE_INTERVAL:
+		element->update_interval = g_value_get_uint64(value);
+		break;
+
+	case ARG_MAX_ITERATIONS:
+		element->max_iterations = g_value_get_int(value);
+		break;
+
+	case ARG_TOLERANCE:
+		element->tolerance = g_value_get_double(value);
+		break;
+
+	case ARG_DIFFERENTIATE:
+		element->differentiate = g_value_get_boolean(value);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstFastICA *element = GST_FASTICA(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_WINDOW:
+		g_value_set_uint64(value, element->window);
+		break;
+
+	case ARG_UPDATE_INTERVAL:
+		g_value_set_uint64(value, element->update_interval);
+		break;
+
+	case ARG_MAX_ITERATIONS:
+		g_value_set_int(value, element->max_iterations);
+		break;
+
+	case ARG_TOLERANCE:
+		g_value_set_double(value, element->tolerance);
+		break;
+
+	case ARG_DIFFERENTIATE:
+		g_value_set_boolean(value, element->differentiate);
+		break;
+
+	case ARG_ITERATIONS:
+		g_value_set_int(value, element->iterations);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void finalize(GObject *object)
+{
+	GstFastICA *element = GST_FASTICA(object);
+
+	g_free(element->history);
+	element->history = NULL;
+	g_free(element->whitened);
+	element->whitened = NULL;
+
+	/*
+	 * chain to parent class' finalize() method
+	 */
+
+	G_OBJECT_CLASS(gst_fastica_parent_class)->finalize(object);
+}
+
+
+#define CAPS \
+	"audio/x-raw, " \
+		"format = (string) " GST_AUDIO_NE(F64) ", " \
+		"channels = (int) 6, " \
+		"rate = (int) [1, MAX], " \
+		"layout = (string) interleaved; " \
+	"audio/x-raw, " \
+		"format = (string) " GST_AUDIO_NE(F64) ", " \
+		"channels = (int) 6, " \
+		"rate = (fraction) [0/1, MAX], " \
+		"layout = (string) interleaved"
+
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SINK_NAME,
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(CAPS)
+);
+
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SRC_NAME,
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(CAPS)
+);
+
+
+static void gst_fastica_class_init(GstFastICAClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->set_property = GST_DEBUG_FUNCPTR(set_property);
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
+	gobject_class->finalize = GST_DEBUG_FUNCPTR(finalize);
+
+	transform_class->set_caps = GST_DEBUG_FUNCPTR(set_caps);
+	transform_class->start = GST_DEBUG_FUNCPTR(start);
+	transform_class->stop = GST_DEBUG_FUNCPTR(stop);
+	transform_class->sink_event = GST_DEBUG_FUNCPTR(sink_event);
+	transform_class->transform_ip = GST_DEBUG_FUNCPTR(transform_ip);
+	/* faceprocessor switches unmixing off with passthrough */
+	transform_class->transform_ip_on_passthrough = FALSE;
+
+	gst_element_class_set_details_simple(element_class,
+		"FastICA RGB unmixer",
+		"Filter/Audio",
+		"Unmixes forehead and cheek R, G, B time series into independent components with FastICA over a sliding window",
+		"Kipp Cannon <kipp.cannon@ligo.org>"
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_WINDOW,
+		g_param_spec_uint64(
+			"window",
+			"Window",
+			"Length of the sliding window from which the unmixing matrix is computed (ns).  Takes effect at the next caps negotiation.",
+			1, G_MAXUINT64, DEFAULT_WINDOW,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_UPDATE_INTERVAL,
+		g_param_spec_uint64(
+			"update-interval",
+			"Update interval",
+			"Time between updates of the unmixing matrix (ns).  Takes effect at the next caps negotiation.",
+			0, G_MAXUINT64, DEFAULT_UPDATE_INTERVAL,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_MAX_ITERATIONS,
+		g_param_spec_int(
+			"max-iterations",
+			"Maximum iterations",
+			"Maximum number of FastICA iterations per update.  Each update starts from the previous result, so an update that stops short of convergence is continued by the next.",
+			1, G_MAXINT, DEFAULT_MAX_ITERATIONS,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_TOLERANCE,
+		g_param_spec_double(
+			"tolerance",
+			"Tolerance",
+			"FastICA has converged when no component's unmixing vector turns by more than this, measured as 1 - |cos angle|.",
+			0.0, 1.0, DEFAULT_TOLERANCE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_DIFFERENTIATE,
+		g_param_spec_boolean(
+			"differentiate",
+			"Differentiate",
+			"Replace the input with its first derivative before unmixing, as rgb2ica.py does, to whiten the background noise spectrum.",
+			DEFAULT_DIFFERENTIATE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_ITERATIONS,
+		g_param_spec_int(
+			"iterations",
+			"Iterations",
+			"Number of FastICA iterations taken by the most recent update.",
+			0, G_MAXINT, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
+}
+
+
+static void gst_fastica_init(GstFastICA *element)
+{
+	element->iterations = 0;
+	element->rate_num = 0;
+	element->rate_den = 1;
+	element->window_length = 0;
+	element->stride = 1;
+	element->history = NULL;
+	element->whitened = NULL;
+	reset(element);
+}
@@ -0,0 +1,137 @@
+/*
+ * GstFastICA
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FASTICA_H__
+#define __FASTICA_H__
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+
+G_BEGIN_DECLS
+
+
+/*
+ * ============================================================================
+ *
+ *                                    Type
+ *
+ * ============================================================================
+ */
+
+
+#define GST_TYPE_FASTICA \
+	(gst_fastica_get_type())
+#define GST_FASTICA(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_FASTICA, GstFastICA))
+#define GST_FASTICA_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_FASTICA, GstFastICAClass))
+#define GST_FASTICA_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_FASTICA, GstFastICAClass))
+#define GST_IS_FASTICA(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_FASTICA))
+#define GST_IS_FASTICA_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_FASTICA))
+
+
+typedef struct _GstFastICAClass GstFastICAClass;
+typedef struct _GstFastICA GstFastICA;
+
+
+struct _GstFastICAClass {
+	GstBaseTransformClass parent_class;
+};
+
+
+/**
+ * GstFastICA
+ */
+
+
+struct _GstFastICA {
+	GstBaseTransform basetransform;
+
+	GstClockTime window;
+	GstClockTime update_interval;
+	gint max_iterations;
+	gdouble tolerance;
+	gboolean differentiate;
+	gint iterations;	/* at the most recent update */
+
+	/*
+	 * negotiated format
+	 */
+
+	gint rate_num, rate_den;
+	guint64 window_length;	/* samples */
+	guint64 stride;	/* samples between updates */
+
+	/*
+	 * sliding window.  the order of the samples doesn't matter to
+	 * the statistics, so the window is a ring buffer used from 0 to
+	 * history_length
+	 */
+
+	gdouble *history;	/* interleaved 6-channel samples */
+	guint64 history_length;
+	guint64 history_next;	/* where the next sample goes */
+	gdouble *whitened;	/* interleaved 3-channel samples */
+
+	/*
+	 * stream state
+	 */
+
+	gdouble previous[6];
+	gboolean have_previous;
+	guint64 since_update;	/* samples */
+	gdouble mean[6];
+	gdouble unmix[3][3];
+	gboolean have_unmix;
+};
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+GType gst_fastica_get_type(void);
+
+
+G_END_DECLS
+
+
+#endif	/* __FASTICA_H__ */
@@ -0,0 +1,332 @@
+/*
+ * GstHistogram2RGB
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * converts the per-region colour histograms produced by face2rgb in
+ * histogram mode into the forehead and cheek RGB time series face2rgb
+ * would have produced for a given gamma.  because the input video is 8
+ * bits per channel, the sum of the gamma-corrected pixel values in a
+ * region is exactly the dot product of the region's histogram with the
+ * table of bin values raised to the power gamma, so the histograms can be
+ * archived and gamma re-tuned without decoding the video again.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <math.h>
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+#include <gst/base/gstbasetransform.h>
+
+
+#include <face2rgb.h>
+#include <histogram2rgb.h>
+
+
+#define DEFAULT_GAMMA 1.0
+
+
+/*
+ * ============================================================================
+ *
+ *                                Boilerplate
+ *
+ * ============================================================================
+ */
+
+
+#define GST_CAT_DEFAULT gst_histogram_2_rgb_debug
+GST_DEBUG_CATEGORY_STATIC(GST_CAT_DEFAULT);
+
+
+static void additional_initializations(void)
+{
+	GST_DEBUG_CATEGORY_INIT(GST_CAT_DEFAULT, "histogram2rgb", 0, "histogram2rgb element");
+}
+
+
+G_DEFINE_TYPE_WITH_CODE(GstHistogram2RGB, gst_histogram_2_rgb, GST_TYPE_BASE_TRANSFORM, additional_initializations(););
+
+
+/*
+ * ============================================================================
+ *
+ *                          GstBaseTransform Methods
+ *
+ * ============================================================================
+ */
+
+
+static gboolean get_unit_size(GstBaseTransform *trans, GstCaps *caps, gsize *size)
+{
+	GstStructure *str = gst_caps_get_structure(caps, 0);
+	gint channels;
+	gboolean success;
+
+	/* can't use gst_audio_info_from_caps():  doesn't understand
+	 * non-integer sample rates */
+	success = gst_structure_get_int(str, "channels", &channels);
+	if(success)
+		*size = channels * (!g_strcmp0(gst_structure_get_string(str, "format"), GST_AUDIO_NE(U32)) ? sizeof(guint32) : sizeof(gdouble));
+	else
+		GST_ERROR_OBJECT(trans, "could not parse caps %" GST_PTR_FORMAT, caps);
+
+	return success;
+}
+
+
+static GstCaps *transform_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+{
+	const GValue *rate = gst_structure_get_value(gst_caps_get_structure(caps, 0), "rate");
+	GstCaps *result;
+	guint n;
+
+	/*
+	 * input and output rates are the same
+	 */
+
+	switch(direction) {
+	case GST_PAD_SRC:
+		result = gst_caps_copy(gst_pad_get_pad_template_caps(GST_BASE_TRANSFORM_SINK_PAD(trans)));
+		break;
+
+	case GST_PAD_SINK:
+		result = gst_caps_copy(gst_pad_get_pad_template_caps(GST_BASE_TRANSFORM_SRC_PAD(trans)));
+		break;
+
+	default:
+		g_assert_not_reached();
+		GST_ELEMENT_ERROR(trans, CORE, NEGOTIATION, (NULL), ("invalid direction"));
+		gst_caps_ref(GST_CAPS_NONE);
+		return GST_CAPS_NONE;
+	}
+
+	if(rate)
+		for(n = 0; n < gst_caps_get_size(result); n++)
+			gst_structure_set_value(gst_caps_get_structure(result, n), "rate", rate);
+
+	if(filter) {
+		caps = result;
+		result = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(caps);
+	}
+
+	return result;
+}
+
+
+static GstFlowReturn transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuffer *outbuf)
+{
+	GstHistogram2RGB *element = GST_HISTOGRAM_2_RGB(trans);
+	const gdouble *table = element->table;
+	GstMapInfo srcmap, dstmap;
+	const guint32 *hist;
+	gdouble sums[FACE_2_RGB_HISTOGRAM_REGIONS][3];
+	guint64 area[FACE_2_RGB_HISTOGRAM_REGIONS];
+	gdouble bg_y;
+	gdouble *out;
+	gint region, colour, i;
+
+	GST_OBJECT_LOCK(element);
+	if(element->need_new_table) {
+		for(i = 0; i < FACE_2_RGB_HISTOGRAM_BINS; i++)
+			element->table[i] = pow(i, element->gamma);
+		element->need_new_table = FALSE;
+	}
+	GST_OBJECT_UNLOCK(element);
+
+	/*
+	 * dot each histogram with the gamma table.  the region's area is
+	 * the total count of any one of its histograms
+	 */
+
+	gst_buffer_map(inbuf, &srcmap, GST_MAP_READ);
+	hist = (const guint32 *) srcmap.data;
+	for(region = 0; region < FACE_2_RGB_HISTOGRAM_REGIONS; region++) {
+		area[region] = 0;
+		for(i = 0; i < FACE_2_RGB_HISTOGRAM_BINS; i++)
+			area[region] += hist[i];
+		for(colour = 0; colour < 3; colour++, hist += FACE_2_RGB_HISTOGRAM_BINS) {
+			gdouble sum = 0.0;
+			for(i = 0; i < FACE_2_RGB_HISTOGRAM_BINS; i++)
+				sum += hist[i] * table[i];
+			sums[region][colour] = sum;
+		}
+	}
+	gst_buffer_unmap(inbuf, &srcmap);
+
+	/*
+	 * normalize as face2rgb does:  regions are listed as background,
+	 * forehead, cheek
+	 */
+
+	bg_y = 0.2126 * sums[0][0] + 0.7152 * sums[0][1] + 0.0722 * sums[0][2];
+
+	gst_buffer_map(outbuf, &dstmap, GST_MAP_WRITE);
+	out = (gdouble *) dstmap.data;
+	for(region = 1; region < FACE_2_RGB_HISTOGRAM_REGIONS; region++) {
+		gdouble bg_over_area_ratio = area[region] ? (gdouble) area[0] / area[region] : 0;
+		for(colour = 0; colour < 3; colour++)
+			*out++ = sums[region][colour] * bg_over_area_ratio / bg_y;
+	}
+	gst_buffer_unmap(outbuf, &dstmap);
+
+	return GST_FLOW_OK;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                              GObject Methods
+ *
+ * ============================================================================
+ */
+
+
+enum property {
+	ARG_GAMMA = 1,
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstHistogram2RGB *element = GST_HISTOGRAM_2_RGB(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_GAMMA:
+		element->gamma = g_value_get_float(value);
+		element->need_new_table = TRUE;
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstHistogram2RGB *element = GST_HISTOGRAM_2_RGB(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_GAMMA:
+		g_value_set_float(value, element->gamma);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SINK_NAME,
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(U32) ", " \
+			"channels = (int) 2304, " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved, " \
+			"channel-mask = (bitmask) 0"
+	)
+);
+
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SRC_NAME,
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = (int) 6, " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved, " \
+			"channel-mask = (bitmask) 0"
+	)
+);
+
+
+static void gst_histogram_2_rgb_class_init(GstHistogram2RGBClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->set_property = GST_DEBUG_FUNCPTR(set_property);
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
+
+	transform_class->get_unit_size = GST_DEBUG_FUNCPTR(get_unit_size);
+	transform_class->transform_caps = GST_DEBUG_FUNCPTR(transform_caps);
+	transform_class->transform = GST_DEBUG_FUNCPTR(transform);
+
+	gst_element_class_set_details_simple(element_class,
+		"Histogram to RGB time series",
+		"Filter/Converter",
+		"Convert face2rgb's per-region colour histograms to gamma-corrected forehead and cheek, red, green, blue time series triples",
+		"Kipp Cannon <kipp.cannon@ligo.org>"
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_GAMMA,
+		g_param_spec_float(
+			"gamma",
+			"gamma",
+			"Gamma correction.",
+			0, G_MAXFLOAT, DEFAULT_GAMMA,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
+}
+
+
+static void gst_histogram_2_rgb_init(GstHistogram2RGB *element)
+{
+	element->need_new_table = TRUE;
+}
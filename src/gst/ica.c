@@ -0,0 +1,349 @@
+/*
+ * Independent component analysis of RGB time series
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * 3x3 linear algebra for unmixing R, G, B time series into independent
+ * components.  an unmixing matrix is stored with one row per component
+ * and one column per colour, so component i of a (de-meaned) sample x is
+ * sum_c unmix[i][c] x[c].  this is the transpose of the unmix matrix in
+ * rgb2ica.py.
+ *
+ * everything is closed-form except the FastICA fixed-point iteration
+ * itself:  the eigenvalues of a symmetric 3x3 matrix are the roots of its
+ * characteristic cubic, found with the trigonometric method, and the
+ * square root of a symmetric positive-definite 3x3 matrix and its inverse
+ * follow from those by the Cayley-Hamilton theorem, without needing the
+ * eigenvectors.  the formulae remain well-conditioned when eigenvalues
+ * are repeated.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <math.h>
+#include <string.h>
+
+
+#include <glib.h>
+
+
+#include <ica.h>
+
+
+/* smallest eigenvalue, relative to the mean eigenvalue, for a matrix to
+ * be treated as positive-definite */
+#define MIN_EIGENVALUE 1e-8
+
+
+/*
+ * ============================================================================
+ *
+ *                             Internal Functions
+ *
+ * ============================================================================
+ */
+
+
+static void mat3_mul_transpose(const gdouble a[3][3], const gdouble b[3][3], gdouble c[3][3])
+{
+	gdouble result[3][3];
+	gint i, j;
+
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++)
+			result[i][j] = a[i][0] * b[j][0] + a[i][1] * b[j][1] + a[i][2] * b[j][2];
+	memcpy(c, result, sizeof(result));
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+/*
+ * c = a b.  c may be a or b.
+ */
+
+
+void ica_mat3_mul(const gdouble a[3][3], const gdouble b[3][3], gdouble c[3][3])
+{
+	gdouble result[3][3];
+	gint i, j;
+
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++)
+			result[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+	memcpy(c, result, sizeof(result));
+}
+
+
+/*
+ * eigenvalues of the symmetric matrix a in descending order (Smith 1961,
+ * Commun. ACM 4, 168).
+ */
+
+
+void ica_sym3_eigenvalues(const gdouble a[3][3], gdouble lambda[3])
+{
+	const gdouble q = (a[0][0] + a[1][1] + a[2][2]) / 3.0;
+	const gdouble p1 = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+	const gdouble p2 = (a[0][0] - q) * (a[0][0] - q) + (a[1][1] - q) * (a[1][1] - q) + (a[2][2] - q) * (a[2][2] - q) + 2.0 * p1;
+	gdouble p, r, phi;
+	gdouble b[3][3];
+	gint i, j;
+
+	if(p2 <= 0.0) {
+		/* a multiple of the identity */
+		lambda[0] = lambda[1] = lambda[2] = q;
+		return;
+	}
+
+	/* b = (a - q 1) / p has eigenvalues 2 cos(phi + 2 pi k / 3) */
+	p = sqrt(p2 / 6.0);
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++)
+			b[i][j] = (a[i][j] - (i == j ? q : 0.0)) / p;
+	r = (b[0][0] * (b[1][1] * b[2][2] - b[1][2] * b[2][1]) - b[0][1] * (b[1][0] * b[2][2] - b[1][2] * b[2][0]) + b[0][2] * (b[1][0] * b[2][1] - b[1][1] * b[2][0])) / 2.0;
+	phi = acos(CLAMP(r, -1.0, 1.0)) / 3.0;
+
+	lambda[0] = q + 2.0 * p * cos(phi);
+	lambda[2] = q + 2.0 * p * cos(phi + 2.0 * M_PI / 3.0);
+	lambda[1] = 3.0 * q - lambda[0] - lambda[2];
+}
+
+
+/*
+ * square root of the symmetric positive-definite matrix a, and its
+ * inverse.  either output may be NULL.  with s the eigenvalues of the
+ * square root u and I, II, III their elementary symmetric polynomials,
+ *
+ *	u = (-a^2 + (I^2 - II) a + I III) / (I II - III)
+ *	u^-1 = (a - I u + II) / III
+ *
+ * (Hoger & Carlson 1984, Q. Appl. Math. 42, 113).  I II - III is the
+ * product of the pairwise sums of the s, so never vanishes.  a is scaled
+ * to unit mean eigenvalue first.  clustered eigenvalues are found only to
+ * about the square root of the machine precision, so u^-1 a u^-1 departs
+ * from the identity by roughly 1e-17 times the square of a's condition
+ * number:  1e-9 at 1e4, ample for whitening.  returns FALSE, leaving the
+ * outputs unmodified, if a is not positive-definite.
+ */
+
+
+gboolean ica_sym3_sqrt(const gdouble a[3][3], gdouble root[3][3], gdouble inv_root[3][3])
+{
+	const gdouble scale = (a[0][0] + a[1][1] + a[2][2]) / 3.0;
+	gdouble b[3][3], b2[3][3], u[3][3];
+	gdouble lambda[3], s[3];
+	gdouble I, II, III;
+	gint i, j;
+
+	if(!(scale > 0.0))
+		return FALSE;
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++)
+			b[i][j] = a[i][j] / scale;
+	ica_sym3_eigenvalues(b, lambda);
+	if(!(lambda[2] > MIN_EIGENVALUE))
+		return FALSE;
+
+	for(i = 0; i < 3; i++)
+		s[i] = sqrt(lambda[i]);
+	I = s[0] + s[1] + s[2];
+	II = s[0] * s[1] + s[1] * s[2] + s[2] * s[0];
+	III = s[0] * s[1] * s[2];
+
+	ica_mat3_mul(b, b, b2);
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++)
+			u[i][j] = (-b2[i][j] + (I * I - II) * b[i][j] + (i == j ? I * III : 0.0)) / (I * II - III);
+
+	if(inv_root)
+		for(i = 0; i < 3; i++)
+			for(j = 0; j < 3; j++)
+				inv_root[i][j] = (b[i][j] - I * u[i][j] + (i == j ? II : 0.0)) / III / sqrt(scale);
+	if(root)
+		for(i = 0; i < 3; i++)
+			for(j = 0; j < 3; j++)
+				root[i][j] = u[i][j] * sqrt(scale);
+
+	return TRUE;
+}
+
+
+/*
+ * symmetric decorrelation, w = (w w^T)^-1/2 w, which makes the rows of w
+ * orthonormal.  returns FALSE, leaving w unmodified, if w is singular.
+ */
+
+
+gboolean ica_sym_decorrelate(gdouble w[3][3])
+{
+	gdouble wwt[3][3], k[3][3];
+
+	mat3_mul_transpose(w, w, wwt);
+	if(!ica_sym3_sqrt(wwt, NULL, k))
+		return FALSE;
+	ica_mat3_mul(k, w, w);
+
+	return TRUE;
+}
+
+
+/*
+ * parallel FastICA with the "exp" contrast, g(y) = y exp(-y^2 / 2), as
+ * used by rgb2ica.py.  z is n interleaved 3-channel samples, already
+ * centred and whitened.  w is the starting point, and is replaced with
+ * the result, one row per component.  iterates until no row of w turns
+ * by more than tolerance (1 - |cos angle|) or max_iterations is reached,
+ * and returns the number of iterations, or -1 if w became singular, in
+ * which case w is left at the last good value.
+ */
+
+
+gint ica_fastica_exp(const gdouble *z, guint64 n, gdouble w[3][3], gint max_iterations, gdouble tolerance)
+{
+	gint iteration;
+
+	if(!n || !ica_sym_decorrelate(w))
+		return -1;
+
+	for(iteration = 1; iteration <= max_iterations; iteration++) {
+		gdouble gz[3][3] = {{0.0}};
+		gdouble gprime[3] = {0.0};
+		gdouble w1[3][3];
+		gdouble lim = 0.0;
+		guint64 k;
+		gint i, c;
+
+		for(k = 0; k < n; k++) {
+			const gdouble *x = z + 3 * k;
+			for(i = 0; i < 3; i++) {
+				const gdouble y = w[i][0] * x[0] + w[i][1] * x[1] + w[i][2] * x[2];
+				const gdouble e = exp(-y * y / 2.0);
+				for(c = 0; c < 3; c++)
+					gz[i][c] += y * e * x[c];
+				gprime[i] += (1.0 - y * y) * e;
+			}
+		}
+
+		for(i = 0; i < 3; i++)
+			for(c = 0; c < 3; c++)
+				w1[i][c] = (gz[i][c] - gprime[i] * w[i][c]) / n;
+		if(!ica_sym_decorrelate(w1))
+			return -1;
+
+		for(i = 0; i < 3; i++)
+			lim = MAX(lim, fabs(fabs(w1[i][0] * w[i][0] + w1[i][1] * w[i][1] + w1[i][2] * w[i][2]) - 1.0));
+		memcpy(w, w1, sizeof(w1));
+		if(lim < tolerance)
+			break;
+	}
+
+	return MIN(iteration, max_iterations);
+}
+
+
+/*
+ * the order and signs that the rules of unmix_rgb() in rgb2ica.py give
+ * the rows of an n x n unmixing matrix, n = 3 or 6.  if n is 6 the
+ * columns are forehead R, G, B then cheek R, G, B, and a component's
+ * colour coefficients are the sums of its forehead and cheek
+ * coefficients divided by the norm of its row:  its response to a colour
+ * change common to both regions relative to its overall gain.
+ * components that pick out differences between the regions, which are
+ * mostly noise, then rank below the pulse however large their
+ * coefficients.  the component with the largest green coefficient comes
+ * first, of the rest the one with the largest blue coefficient second,
+ * and of the rest the one with the largest red coefficient third (for
+ * n = 3 that is the one left over).  any others follow in order of
+ * decreasing green coefficient.  the green coefficient of the first is
+ * made negative, the blue coefficient of the second positive, the red
+ * coefficient of the third positive, and the green coefficients of any
+ * others negative.  on return row order[k] of unmix belongs at position
+ * k, and is to be negated if negate[k] is TRUE.
+ */
+
+
+void ica_canonical_order(const gdouble *unmix, gint n, gint *order, gboolean *negate)
+{
+	static const gint rules[] = {1, 2, 0};	/* colour selecting each position */
+	gdouble colour[6][3];
+	gboolean used[6] = {FALSE};
+	gint k, i, c;
+
+	g_assert(n == 3 || n == 6);
+
+	for(i = 0; i < n; i++) {
+		const gdouble *row = unmix + i * n;
+
+		if(n == 3)
+			memcpy(colour[i], row, sizeof(colour[i]));
+		else {
+			const gdouble norm = sqrt(row[0] * row[0] + row[1] * row[1] + row[2] * row[2] + row[3] * row[3] + row[4] * row[4] + row[5] * row[5]);
+			for(c = 0; c < 3; c++)
+				colour[i][c] = (row[c] + row[3 + c]) / norm;
+		}
+	}
+
+	for(k = 0; k < n; k++) {
+		c = k < 3 ? rules[k] : 1;
+		order[k] = -1;
+		for(i = 0; i < n; i++)
+			if(!used[i] && (order[k] < 0 || fabs(colour[i][c]) > fabs(colour[order[k]][c])))
+				order[k] = i;
+		used[order[k]] = TRUE;
+		/* green negative, blue and red positive */
+		negate[k] = c == 1 ? colour[order[k]][c] > 0.0 : colour[order[k]][c] < 0.0;
+	}
+}
+
+
+/*
+ * put the rows of a 3x3 unmixing matrix in canonical order and sign
+ */
+
+
+void ica_canonicalize(gdouble unmix[3][3])
+{
+	gdouble result[3][3];
+	gint order[3];
+	gboolean negate[3];
+	gint k, c;
+
+	ica_canonical_order(&unmix[0][0], 3, order, negate);
+	for(k = 0; k < 3; k++)
+		for(c = 0; c < 3; c++)
+			result[k][c] = negate[k] ? -unmix[order[k]][c] : unmix[order[k]][c];
+	memcpy(unmix, result, sizeof(result));
+}
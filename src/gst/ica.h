@@ -0,0 +1,62 @@
+/*
+ * Independent component analysis of RGB time series
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __ICA_H__
+#define __ICA_H__
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+
+
+G_BEGIN_DECLS
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+void ica_mat3_mul(const gdouble a[3][3], const gdouble b[3][3], gdouble c[3][3]);
+void ica_sym3_eigenvalues(const gdouble a[3][3], gdouble lambda[3]);
+gboolean ica_sym3_sqrt(const gdouble a[3][3], gdouble root[3][3], gdouble inv_root[3][3]);
+gboolean ica_sym_decorrelate(gdouble w[3][3]);
+gint ica_fastica_exp(const gdouble *z, guint64 n, gdouble w[3][3], gint max_iterations, gdouble tolerance);
+void ica_canonical_order(const gdouble *unmix, gint n, gint *order, gboolean *negate);
+void ica_canonicalize(gdouble unmix[3][3]);
+
+
+G_END_DECLS
+
+
+#endif	/* __ICA_H__ */
@@ -0,0 +1,719 @@
+/*
+ * GstIrregularResample
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * resamples a time series whose samples are irregularly spaced in time
+ * onto a uniform output grid.  each input sample is placed at its own
+ * timestamp rather than at the position implied by its offset and the
+ * nominal sample rate, so jitter, dropped frames and duplicated frames in
+ * the source are handled without first forcing the video to a nominal
+ * frame rate.  each output sample is the weighted mean of the input
+ * samples within half_width of it, the weights given by a
+ * Blackman-windowed sinc kernel whose time scale is the longer of the
+ * nominal input and output sample periods.  because the weights are
+ * normalized by their sum, missing input samples do not change the output
+ * level.  the sinc's negative lobes mean that, with enough samples
+ * missing, that sum can approach 0 and the mean blow up, so if it is
+ * less than MIN_NORM times the sum of the weights' magnitudes the nearest
+ * input sample is held instead.  otherwise no output exceeds 1 / MIN_NORM
+ * times the largest input.  a complete, regularly-sampled input never has
+ * a ratio below about 0.52, so MIN_NORM leaves it alone.  input samples
+ * whose timestamps do not increase are discarded.
+ * a change of sample rate mid-stream keeps the history and restarts the
+ * output grid at the time of the next output sample, so the output
+ * continues without a transient.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <math.h>
+#include <string.h>
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+#include <gst/base/gstbasetransform.h>
+
+
+#include <settling.h>
+#include <irregularresample.h>
+
+
+#define KERNEL_HALF_LENGTH 8	/* kernel time scales per side */
+#define MIN_NORM 0.4	/* smallest sum of weights / sum of |weights| */
+
+
+/*
+ * ============================================================================
+ *
+ *                                Boilerplate
+ *
+ * ============================================================================
+ */
+
+
+#define GST_CAT_DEFAULT gst_irregular_resample_debug
+GST_DEBUG_CATEGORY_STATIC(GST_CAT_DEFAULT);
+
+
+static void additional_initializations(void)
+{
+	GST_DEBUG_CATEGORY_INIT(GST_CAT_DEFAULT, "irregularresample", 0, "irregularresample element");
+}
+
+
+G_DEFINE_TYPE_WITH_CODE(GstIrregularResample, gst_irregular_resample, GST_TYPE_BASE_TRANSFORM, additional_initializations(););
+
+
+/*
+ * ============================================================================
+ *
+ *                             Internal Functions
+ *
+ * ============================================================================
+ */
+
+
+static gboolean get_rate(GstStructure *s, gint *num, gint *den)
+{
+	*den = 1;
+	return gst_structure_get_int(s, "rate", num) || gst_structure_get_fraction(s, "rate", num, den);
+}
+
+
+/*
+ * Blackman-windowed sinc kernel.  x is in units of the kernel time scale
+ */
+
+
+static gdouble kernel(gdouble x)
+{
+	gdouble w = x / KERNEL_HALF_LENGTH;
+
+	if(fabs(w) >= 1.0)
+		return 0.0;
+	return (x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x)) * (0.42 + 0.5 * cos(M_PI * w) + 0.08 * cos(2.0 * M_PI * w));
+}
+
+
+static void reset(GstIrregularResample *element)
+{
+	element->length = 0;
+	element->next_out = 0;
+	element->t0 = GST_CLOCK_TIME_NONE;
+	element->need_discont = TRUE;
+}
+
+
+static GstClockTime output_time(GstIrregularResample *element, guint64 k)
+{
+	return element->t0 + gst_util_uint64_scale_round(k, (guint64) GST_SECOND * element->outrate_den, element->outrate_num);
+}
+
+
+static void append_samples(GstIrregularResample *element, GstClockTime t, GstClockTime dt, const gdouble *data, guint n)
+{
+	const gint channels = element->channels;
+	guint i;
+
+	if(element->length + n > element->size) {
+		element->size = MAX(element->length + n, 2 * element->size);
+		element->times = g_realloc_n(element->times, element->size, sizeof(*element->times));
+		element->history = g_realloc_n(element->history, element->size * channels, sizeof(*element->history));
+	}
+	for(i = 0; i < n; i++, data += channels) {
+		GstClockTime ti = t + i * dt;
+		if(element->length && ti <= element->times[element->length - 1]) {
+			GST_LOG_OBJECT(element, "discarding sample at %" GST_TIME_FORMAT ":  timestamp does not increase", GST_TIME_ARGS(ti));
+			continue;
+		}
+		element->times[element->length] = ti;
+		memcpy(element->history + element->length * channels, data, channels * sizeof(*data));
+		element->length++;
+	}
+}
+
+
+/*
+ * number of output samples whose time is at or before t
+ */
+
+
+static guint64 available(GstIrregularResample *element, GstClockTime t)
+{
+	guint64 end;
+
+	if(!GST_CLOCK_TIME_IS_VALID(element->t0) || !GST_CLOCK_TIME_IS_VALID(t) || t < element->t0)
+		return 0;
+	end = gst_util_uint64_scale(t - element->t0, element->outrate_num, (guint64) GST_SECOND * element->outrate_den) + 1;
+	return end > element->next_out ? end - element->next_out : 0;
+}
+
+
+static void resample(GstIrregularResample *element, gdouble *out, guint64 n)
+{
+	const gint channels = element->channels;
+	guint first = 0;
+	guint64 k;
+
+	for(k = element->next_out; k < element->next_out + n; k++, out += channels) {
+		const GstClockTime t = output_time(element, k);
+		gdouble norm = 0.0, abs_norm = 0.0;
+		guint i;
+		gint c;
+
+		memset(out, 0, channels * sizeof(*out));
+		while(first < element->length && element->times[first] + element->half_width < t)
+			first++;
+		for(i = first; i < element->length && element->times[i] <= t + element->half_width; i++) {
+			const gdouble *x = element->history + i * channels;
+			const gdouble w = kernel(((gdouble) element->times[i] - (gdouble) t) / element->period);
+			for(c = 0; c < channels; c++)
+				out[c] += w * x[c];
+			norm += w;
+			abs_norm += fabs(w);
+		}
+
+		if(norm > 0.0 && norm >= MIN_NORM * abs_norm)
+			for(c = 0; c < channels; c++)
+				out[c] /= norm;
+		else {
+			/* no input within reach of the kernel, or too little
+			 * of it in the main lobe:  hold the nearest sample */
+			i = MIN(first, element->length - 1);
+			if(i > 0 && element->times[i] > t && t - element->times[i - 1] < element->times[i] - t)
+				i--;
+			memcpy(out, element->history + i * channels, channels * sizeof(*out));
+		}
+	}
+}
+
+
+/*
+ * discard input samples no longer needed to compute the next output
+ * sample.  the latest is always kept
+ */
+
+
+static void trim_history(GstIrregularResample *element)
+{
+	const GstClockTime t = output_time(element, element->next_out);
+	guint drop = 0;
+
+	while(drop + 1 < element->length && element->times[drop] + element->half_width < t)
+		drop++;
+	if(!drop)
+		return;
+	memmove(element->times, element->times + drop, (element->length - drop) * sizeof(*element->times));
+	memmove(element->history, element->history + drop * element->channels, (element->length - drop) * element->channels * sizeof(*element->history));
+	element->length -= drop;
+}
+
+
+static void set_metadata(GstIrregularResample *element, GstBuffer *buf, guint64 n)
+{
+	const guint64 k = element->next_out;
+
+	GST_BUFFER_PTS(buf) = output_time(element, k);
+	GST_BUFFER_DURATION(buf) = output_time(element, k + n) - GST_BUFFER_PTS(buf);
+	GST_BUFFER_OFFSET(buf) = element->offset0 + k;
+	GST_BUFFER_OFFSET_END(buf) = element->offset0 + k + n;
+	if(element->need_discont) {
+		GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DISCONT);
+		element->need_discont = FALSE;
+	}
+}
+
+
+/*
+ * compute and push the output samples up to the last input sample, and
+ * reset.
+ */
+
+
+static GstFlowReturn drain(GstIrregularResample *element)
+{
+	GstFlowReturn result = GST_FLOW_OK;
+	guint64 n;
+
+	if(!element->length)
+		goto done;
+
+	n = available(element, element->times[element->length - 1]);
+	GST_DEBUG_OBJECT(element, "draining %" G_GUINT64_FORMAT " samples", n);
+	if(n) {
+		GstBuffer *buf = gst_buffer_new_allocate(NULL, n * element->channels * sizeof(gdouble), NULL);
+		GstMapInfo map;
+
+		gst_buffer_map(buf, &map, GST_MAP_WRITE);
+		resample(element, (gdouble *) map.data, n);
+		gst_buffer_unmap(buf, &map);
+		set_metadata(element, buf, n);
+		element->next_out += n;
+		result = gst_pad_push(GST_BASE_TRANSFORM_SRC_PAD(element), buf);
+	}
+
+done:
+	reset(element);
+	return result;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                          GstBaseTransform Methods
+ *
+ * ============================================================================
+ */
+
+
+static gboolean get_unit_size(GstBaseTransform *trans, GstCaps *caps, gsize *size)
+{
+	gint channels;
+	gboolean success = gst_structure_get_int(gst_caps_get_structure(caps, 0), "channels", &channels);
+
+	/* can't use gst_audio_info_from_caps():  doesn't understand
+	 * non-integer sample rates */
+	if(success)
+		*size = channels * sizeof(gdouble);
+	else
+		GST_ERROR_OBJECT(trans, "could not parse caps %" GST_PTR_FORMAT, caps);
+
+	return success;
+}
+
+
+static GstCaps *transform_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+{
+	GstCaps *othercaps = NULL;
+	guint i;
+
+	/*
+	 * sink and source pads must have same channel count.  the output
+	 * rate is free, but the input's nominal rate is listed first so
+	 * that it is preferred.
+	 */
+
+	/* make a copy of caps with all rate elements removed */
+	othercaps = gst_caps_copy(caps);
+	for(i = 0; i < gst_caps_get_size(othercaps); i++)
+		gst_structure_remove_field(gst_caps_get_structure(othercaps, i), "rate");
+	/* append the result to a copy of caps, and free */
+	caps = gst_caps_copy(caps);
+	gst_caps_append(caps, othercaps);
+
+	/* intersect that result with the caps allowed by the pad template.
+	 * this repopulates the rate elements with the allowed ranges */
+	switch(direction) {
+	case GST_PAD_SRC: {
+		GstCaps *tmpltcaps = gst_pad_get_pad_template_caps(GST_BASE_TRANSFORM_SINK_PAD(trans));
+		othercaps = gst_caps_intersect_full(caps, tmpltcaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(tmpltcaps);
+		break;
+	}
+
+	case GST_PAD_SINK: {
+		GstCaps *tmpltcaps = gst_pad_get_pad_template_caps(GST_BASE_TRANSFORM_SRC_PAD(trans));
+		othercaps = gst_caps_intersect_full(caps, tmpltcaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(tmpltcaps);
+		break;
+	}
+
+	default:
+		g_assert_not_reached();
+		GST_ELEMENT_ERROR(trans, CORE, NEGOTIATION, (NULL), ("invalid direction GST_PAD_UNKNOWN"));
+		gst_caps_ref(GST_CAPS_NONE);
+		othercaps = GST_CAPS_NONE;
+		break;
+	}
+	gst_caps_unref(caps);
+
+	if(filter) {
+		caps = othercaps;
+		othercaps = gst_caps_intersect_full(filter, othercaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(caps);
+	}
+
+	GST_DEBUG_OBJECT(trans, "transformed to %" GST_PTR_FORMAT, othercaps);
+
+	return othercaps;
+}
+
+
+static GstCaps *fixate_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *othercaps)
+{
+	GstStructure *s;
+	gint rate_num, rate_den;
+
+	if(!get_rate(gst_caps_get_structure(caps, 0), &rate_num, &rate_den)) {
+		GST_ERROR_OBJECT(trans, "could not deduce rate from %" GST_PTR_FORMAT, caps);
+		return othercaps;
+	}
+
+	othercaps = gst_caps_truncate(othercaps);
+	s = gst_caps_get_structure(othercaps, 0);
+	if(gst_structure_has_field_typed(s, "rate", G_TYPE_INT))
+		gst_structure_fixate_field_nearest_int(s, "rate", rate_den == 1 ? rate_num : (int) round((double) rate_num / rate_den));
+	else if(gst_structure_has_field_typed(s, "rate", GST_TYPE_FRACTION))
+		gst_structure_fixate_field_nearest_fraction(s, "rate", rate_num, rate_den);
+
+	return gst_caps_fixate(othercaps);
+}
+
+
+static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps)
+{
+	GstIrregularResample *element = GST_IRREGULAR_RESAMPLE(trans);
+	gint channels, inrate_num, inrate_den, outrate_num, outrate_den;
+	gdouble period;
+	GstClockTime half_width;
+	gboolean success = TRUE;
+
+	success &= gst_structure_get_int(gst_caps_get_structure(incaps, 0), "channels", &channels);
+	success &= get_rate(gst_caps_get_structure(incaps, 0), &inrate_num, &inrate_den);
+	success &= get_rate(gst_caps_get_structure(outcaps, 0), &outrate_num, &outrate_den);
+	if(!success || outrate_num <= 0) {
+		GST_ERROR_OBJECT(element, "failed to parse rates from incaps = %" GST_PTR_FORMAT ", outcaps = %" GST_PTR_FORMAT, incaps, outcaps);
+		return FALSE;
+	}
+
+	if(element->length && channels != element->channels) {
+		GST_WARNING_OBJECT(element, "channel count changed, discarding %u samples of history", element->length);
+		reset(element);
+	}
+
+	/*
+	 * kernel time scale is the longer of the nominal input and output
+	 * sample periods.  an input rate of 0 means variable, and the
+	 * output period is used
+	 */
+
+	period = (gdouble) GST_SECOND * outrate_den / outrate_num;
+	if(inrate_num > 0)
+		period = MAX(period, (gdouble) GST_SECOND * inrate_den / inrate_num);
+
+	half_width = ceil(KERNEL_HALF_LENGTH * period);
+
+	/*
+	 * a rate change mid-stream keeps the history.  the output grid is
+	 * restarted at the time of the next output sample.  if the new
+	 * kernel is wider than the old, the output samples it reaches back
+	 * into discarded history with are computed from fewer input
+	 * samples than normal
+	 */
+
+	if(GST_CLOCK_TIME_IS_VALID(element->t0) && (outrate_num != element->outrate_num || outrate_den != element->outrate_den || half_width != element->half_width)) {
+		GstClockTime t = output_time(element, element->next_out);
+
+		element->t0 = t;
+		element->offset0 = gst_util_uint64_scale_round(t, outrate_num, (guint64) GST_SECOND * outrate_den);
+		element->next_out = 0;
+		settling_post(GST_ELEMENT(element), GST_CAT_DEFAULT, &element->settling_time, t, half_width > element->half_width ? half_width - element->half_width : 0);
+	}
+
+	element->channels = channels;
+	element->outrate_num = outrate_num;
+	element->outrate_den = outrate_den;
+	element->period = period;
+	element->half_width = half_width;
+
+	GST_DEBUG_OBJECT(element, "%d/%d Hz --> %d/%d Hz:  kernel time scale %g ns", inrate_num, inrate_den, outrate_num, outrate_den, period);
+
+	return TRUE;
+}
+
+
+static gboolean start(GstBaseTransform *trans)
+{
+	reset(GST_IRREGULAR_RESAMPLE(trans));
+
+	return TRUE;
+}
+
+
+static gboolean stop(GstBaseTransform *trans)
+{
+	GstIrregularResample *element = GST_IRREGULAR_RESAMPLE(trans);
+
+	g_free(element->times);
+	element->times = NULL;
+	g_free(element->history);
+	element->history = NULL;
+	element->size = 0;
+	reset(element);
+
+	return TRUE;
+}
+
+
+static gboolean sink_event(GstBaseTransform *trans, GstEvent *event)
+{
+	GstIrregularResample *element = GST_IRREGULAR_RESAMPLE(trans);
+
+	switch(GST_EVENT_TYPE(event)) {
+	case GST_EVENT_EOS:
+		drain(element);
+		break;
+
+	case GST_EVENT_FLUSH_STOP:
+		reset(element);
+		break;
+
+	default:
+		break;
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(gst_irregular_resample_parent_class)->sink_event(trans, event);
+}
+
+
+/*
+ * the number of output samples depends on the timestamps of the input
+ * samples, not on the size of the input buffer, so the queued input is
+ * absorbed here and the output buffer sized accordingly.  an input
+ * buffer that completes no output samples produces no buffer, rather
+ * than GST_BASE_TRANSFORM_FLOW_DROPPED, which would have the next buffer
+ * marked as a discontinuity.  the output grid continues across gaps in
+ * the input, so output is marked as one only after a drain
+ */
+
+
+static GstFlowReturn generate_output(GstBaseTransform *trans, GstBuffer **outbuf)
+{
+	GstIrregularResample *element = GST_IRREGULAR_RESAMPLE(trans);
+	GstBuffer *inbuf = trans->queued_buf;
+	GstFlowReturn result = GST_FLOW_OK;
+	GstClockTime t, dt;
+	GstMapInfo map;
+	guint64 n;
+
+	*outbuf = NULL;
+	if(!inbuf)
+		goto done;
+	trans->queued_buf = NULL;
+
+	if(!GST_BUFFER_PTS_IS_VALID(inbuf)) {
+		GST_ELEMENT_ERROR(element, STREAM, FORMAT, (NULL), ("input buffer has no timestamp"));
+		result = GST_FLOW_ERROR;
+		goto unref;
+	}
+	t = GST_BUFFER_PTS(inbuf);
+
+	/*
+	 * a jump backwards in time restarts the output grid
+	 */
+
+	if(element->length && t <= element->times[element->length - 1] && GST_BUFFER_IS_DISCONT(inbuf)) {
+		GST_DEBUG_OBJECT(element, "timestamps restart at %" GST_TIME_FORMAT, GST_TIME_ARGS(t));
+		result = drain(element);
+		if(result != GST_FLOW_OK)
+			goto unref;
+	}
+
+	gst_buffer_map(inbuf, &map, GST_MAP_READ);
+	n = map.size / (element->channels * sizeof(gdouble));
+	if(n) {
+		/* samples within a buffer are spread evenly over its
+		 * duration.  face2rgb produces one sample per buffer */
+		dt = n > 1 && GST_BUFFER_DURATION_IS_VALID(inbuf) ? GST_BUFFER_DURATION(inbuf) / n : 0;
+		if(!GST_CLOCK_TIME_IS_VALID(element->t0)) {
+			element->t0 = t;
+			element->offset0 = gst_util_uint64_scale_round(t, element->outrate_num, (guint64) GST_SECOND * element->outrate_den);
+		}
+		append_samples(element, t, dt, (const gdouble *) map.data, n);
+	}
+	gst_buffer_unmap(inbuf, &map);
+
+	/*
+	 * output samples are complete once an input sample beyond the
+	 * kernel's reach has arrived
+	 */
+
+	t = element->length ? element->times[element->length - 1] : GST_CLOCK_TIME_NONE;
+	n = GST_CLOCK_TIME_IS_VALID(t) && t >= element->half_width ? available(element, t - element->half_width) : 0;
+	if(n) {
+		*outbuf = gst_buffer_new_allocate(NULL, n * element->channels * sizeof(gdouble), NULL);
+		gst_buffer_map(*outbuf, &map, GST_MAP_WRITE);
+		resample(element, (gdouble *) map.data, n);
+		gst_buffer_unmap(*outbuf, &map);
+		set_metadata(element, *outbuf, n);
+		element->next_out += n;
+		trim_history(element);
+	}
+
+unref:
+	gst_buffer_unref(inbuf);
+done:
+	return result;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                              GObject Methods
+ *
+ * ============================================================================
+ */
+
+
+enum property {
+	ARG_SETTLING_TIME = 1,
+};
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstIrregularResample *element = GST_IRREGULAR_RESAMPLE(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_SETTLING_TIME:
+		g_value_set_uint64(value, element->settling_time);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void finalize(GObject *object)
+{
+	GstIrregularResample *element = GST_IRREGULAR_RESAMPLE(object);
+
+	g_free(element->times);
+	element->times = NULL;
+	g_free(element->history);
+	element->history = NULL;
+
+	/*
+	 * chain to parent class' finalize() method
+	 */
+
+	G_OBJECT_CLASS(gst_irregular_resample_parent_class)->finalize(object);
+}
+
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SINK_NAME,
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (int) [1, MAX], " \
+			"layout = (string) interleaved; " \
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved"
+	)
+);
+
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SRC_NAME,
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (int) [1, MAX], " \
+			"layout = (string) interleaved; " \
+		"audio/x-raw, " \
+			"format = (string) " GST_AUDIO_NE(F64) ", " \
+			"channels = " GST_AUDIO_CHANNELS_RANGE ", " \
+			"rate = (fraction) [0/1, MAX], " \
+			"layout = (string) interleaved"
+	)
+);
+
+
+static void gst_irregular_resample_class_init(GstIrregularResampleClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
+	gobject_class->finalize = GST_DEBUG_FUNCPTR(finalize);
+
+	transform_class->get_unit_size = GST_DEBUG_FUNCPTR(get_unit_size);
+	transform_class->transform_caps = GST_DEBUG_FUNCPTR(transform_caps);
+	transform_class->fixate_caps = GST_DEBUG_FUNCPTR(fixate_caps);
+	transform_class->set_caps = GST_DEBUG_FUNCPTR(set_caps);
+	transform_class->start = GST_DEBUG_FUNCPTR(start);
+	transform_class->stop = GST_DEBUG_FUNCPTR(stop);
+	transform_class->sink_event = GST_DEBUG_FUNCPTR(sink_event);
+	transform_class->generate_output = GST_DEBUG_FUNCPTR(generate_output);
+
+	gst_element_class_set_details_simple(element_class,
+		"Irregular sample resampler",
+		"Filter/Converter/Audio",
+		"Resamples a time series with irregularly spaced timestamps onto a uniform grid with a normalized windowed-sinc kernel",
+		"Kipp Cannon <kipp.cannon@ligo.org>"
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_SETTLING_TIME,
+		g_param_spec_uint64(
+			"settling-time",
+			"Settling time",
+			"Length of output affected by the most recent change of sample rate (ns).  0 unless the kernel grew.  A \"settling\" element message with \"timestamp\" and \"duration\" fields is posted at each change.",
+			0, G_MAXUINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
+}
+
+
+static void gst_irregular_resample_init(GstIrregularResample *element)
+{
+	element->channels = 0;
+	element->times = NULL;
+	element->history = NULL;
+	element->size = 0;
+	element->half_width = 0;
+	element->settling_time = 0;
+	reset(element);
+}
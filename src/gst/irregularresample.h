@@ -0,0 +1,123 @@
+/*
+ * GstIrregularResample
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __IRREGULAR_RESAMPLE_H__
+#define __IRREGULAR_RESAMPLE_H__
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+
+G_BEGIN_DECLS
+
+
+/*
+ * ============================================================================
+ *
+ *                                    Type
+ *
+ * ============================================================================
+ */
+
+
+#define GST_TYPE_IRREGULAR_RESAMPLE \
+	(gst_irregular_resample_get_type())
+#define GST_IRREGULAR_RESAMPLE(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IRREGULAR_RESAMPLE, GstIrregularResample))
+#define GST_IRREGULAR_RESAMPLE_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IRREGULAR_RESAMPLE, GstIrregularResampleClass))
+#define GST_IRREGULAR_RESAMPLE_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_IRREGULAR_RESAMPLE, GstIrregularResampleClass))
+#define GST_IS_IRREGULAR_RESAMPLE(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IRREGULAR_RESAMPLE))
+#define GST_IS_IRREGULAR_RESAMPLE_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IRREGULAR_RESAMPLE))
+
+
+typedef struct _GstIrregularResampleClass GstIrregularResampleClass;
+typedef struct _GstIrregularResample GstIrregularResample;
+
+
+struct _GstIrregularResampleClass {
+	GstBaseTransformClass parent_class;
+};
+
+
+/**
+ * GstIrregularResample
+ */
+
+
+struct _GstIrregularResample {
+	GstBaseTransform basetransform;
+
+	/*
+	 * negotiated format
+	 */
+
+	gint channels;
+	gint outrate_num, outrate_den;
+	gdouble period;	/* kernel time scale, ns */
+	GstClockTime half_width;	/* ns */
+
+	/*
+	 * stream state.  the input samples are kept with their
+	 * timestamps
+	 */
+
+	GstClockTime *times;
+	gdouble *history;	/* interleaved */
+	guint length, size;	/* samples */
+	GstClockTime t0;	/* timestamp of output sample 0 */
+	guint64 offset0;
+	guint64 next_out;	/* index of next output sample */
+	gboolean need_discont;
+	GstClockTime settling_time;	/* after the most recent rate change */
+};
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+GType gst_irregular_resample_get_type(void);
+
+
+G_END_DECLS
+
+
+#endif	/* __IRREGULAR_RESAMPLE_H__ */
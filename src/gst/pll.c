@@ -0,0 +1,329 @@
+/*
+ * Software sample clock recovery
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * reconstructs the times of samples produced by a device with a uniform
+ * but unknown sample clock from their jittery times-of-arrival.  a
+ * first-order loop predicts the time of each sample from the previous
+ * sample's time and the current period estimate, and a fraction of the
+ * error between the prediction and the time-of-arrival is fed back into
+ * each of the phase and the period.  smaller gains give a narrower loop
+ * bandwidth:  better jitter rejection, slower to acquire and to track
+ * drift.
+ *
+ * the loop is declared locked when the phase error has been within
+ * lock_threshold periods for lock_count consecutive samples, and unlocked
+ * when it exceeds unlock_threshold periods.
+ *
+ * the loop bandwidth can be made adaptive.  while unlocked both gains are
+ * multiplied by an acquisition boost, widening the loop so that it locks
+ * quickly;  once locked the multiplier decays geometrically, by
+ * boost_decay per sample, to 1, narrowing the loop to reject jitter
+ * without the transient an abrupt change of gain would cause.  losing
+ * lock restores the boost.
+ *
+ * input the loop can't follow does not stop it.  a sample that arrives so
+ * early that the period would have to become 0 or negative to reach it,
+ * e.g. an outlier with a large frequency gain or a time base that has
+ * stepped backwards, is counted as a fault, the period is kept, and the
+ * phase is reacquired from that sample.  so is a sample no later than
+ * the first when the period is being measured from their spacing.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include <glib.h>
+#include <gst/gst.h>
+
+
+#include <pll.h>
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+struct pll *pll_new(gdouble phase_gain, gdouble frequency_gain)
+{
+	struct pll *pll = g_new(struct pll, 1);
+
+	pll->phase_gain = phase_gain;
+	pll->frequency_gain = frequency_gain;
+	pll->lock_threshold = PLL_DEFAULT_LOCK_THRESHOLD;
+	pll->unlock_threshold = PLL_DEFAULT_UNLOCK_THRESHOLD;
+	pll->lock_count = PLL_DEFAULT_LOCK_COUNT;
+	pll->acquisition_boost = 1.0;
+	pll->boost_decay = PLL_DEFAULT_BOOST_DECAY;
+	pll->dt = 0;
+	pll_reset(pll);
+
+	return pll;
+}
+
+
+void pll_free(struct pll *pll)
+{
+	g_free(pll);
+}
+
+
+/*
+ * forget the phase and the statistics.  the period estimate is kept
+ */
+
+
+void pll_reset(struct pll *pll)
+{
+	pll->t = GST_CLOCK_TIME_NONE;
+	pll->locked = FALSE;
+	pll->in_threshold = 0;
+	pll->boost = pll->acquisition_boost;
+	pll->samples = 0;
+	pll->faults = 0;
+	pll->error_sum_sq = 0.0;
+	memset(pll->histogram, 0, sizeof(pll->histogram));
+	pll->t_unlocked = GST_CLOCK_TIME_NONE;
+	pll->lock_time = GST_CLOCK_TIME_NONE;
+}
+
+
+/*
+ * seed the period estimate, e.g. from a nominal sample rate.  if not set,
+ * or not positive, the spacing of the first two samples is used
+ */
+
+
+void pll_set_period(struct pll *pll, GstClockTimeDiff dt)
+{
+	pll->dt = MAX(dt, 0);
+}
+
+
+/*
+ * multiply the gains by boost while unlocked.  1 (or less) disables
+ * adaptation
+ */
+
+
+void pll_set_acquisition_boost(struct pll *pll, gdouble boost)
+{
+	pll->acquisition_boost = MAX(boost, 1.0);
+	if(!pll->locked)
+		pll->boost = pll->acquisition_boost;
+}
+
+
+/*
+ * if the loop is locked and t is about n >= 1 periods later than the
+ * next tick, assume the n samples before it were lost and advance the
+ * phase past them without feedback.  returns n.  while unlocked the
+ * period can't be trusted to count the missing samples, and 0 is
+ * returned.  for sources that drop samples rather than deliver them
+ * late;  call before pll_correct()
+ */
+
+
+guint64 pll_skip_missing(struct pll *pll, GstClockTime t)
+{
+	GstClockTimeDiff error;
+	guint64 n;
+
+	if(!pll->locked || pll->dt <= 0 || !GST_CLOCK_TIME_IS_VALID(t))
+		return 0;
+	error = GST_CLOCK_DIFF(pll->t + pll->dt, t);
+	if(2 * error < pll->dt)
+		return 0;
+	n = (error + pll->dt / 2) / pll->dt;
+	pll->t += n * pll->dt;
+	return n;
+}
+
+
+GstClockTime pll_correct(struct pll *pll, GstClockTime t, gboolean *locked)
+{
+	GstClockTimeDiff error, dt;
+	gdouble phase;
+	gint bin;
+
+	if(!GST_CLOCK_TIME_IS_VALID(t))
+		goto done;
+
+	if(!GST_CLOCK_TIME_IS_VALID(pll->t)) {
+		pll->t = t;
+		pll->locked = FALSE;
+		pll->t_unlocked = t;
+		goto done;
+	}
+
+	if(!pll->dt) {
+		if(t <= pll->t) {
+			/* no spacing to measure.  start again */
+			pll->t = t;
+			pll->faults++;
+			goto done;
+		}
+		pll->dt = t - pll->t;
+	}
+	pll->t += pll->dt;
+
+	error = GST_CLOCK_DIFF(pll->t, t);	/* t - pll->t */
+
+	/*
+	 * statistics and lock detection
+	 */
+
+	phase = pll->dt ? (gdouble) error / pll->dt : 0.0;
+	pll->samples++;
+	pll->error_sum_sq += phase * phase;
+	bin = floor((phase + 1.0) / 2.0 * PLL_HISTOGRAM_BINS);
+	pll->histogram[CLAMP(bin, 0, PLL_HISTOGRAM_BINS - 1)]++;
+
+	if(fabs(phase) <= pll->lock_threshold)
+		pll->in_threshold++;
+	else
+		pll->in_threshold = 0;
+	if(pll->locked && fabs(phase) > pll->unlock_threshold) {
+		pll->locked = FALSE;
+		pll->boost = pll->acquisition_boost;
+		pll->t_unlocked = t;
+	} else if(!pll->locked && pll->in_threshold >= pll->lock_count) {
+		pll->locked = TRUE;
+		pll->lock_time = t - pll->t_unlocked;
+	}
+
+	/*
+	 * feedback
+	 */
+
+	dt = pll->dt + (GstClockTimeDiff) llround(error * pll->frequency_gain * pll->boost);
+	if(dt <= 0) {
+		/* can't follow this sample.  keep the period and
+		 * reacquire */
+		pll->t = t;
+		pll->faults++;
+		pll->locked = FALSE;
+		pll->in_threshold = 0;
+		pll->boost = pll->acquisition_boost;
+		pll->t_unlocked = t;
+		goto done;
+	}
+	pll->t += (GstClockTimeDiff) llround(error * pll->phase_gain * pll->boost);
+	pll->dt = dt;
+	if(pll->locked)
+		pll->boost = MAX(pll->boost * pll->boost_decay, 1.0);
+
+done:
+	if(locked)
+		*locked = pll->locked;
+	return pll->t;
+}
+
+
+GstClockTimeDiff pll_period(const struct pll *pll)
+{
+	return pll->dt;
+}
+
+
+/*
+ * Hz, 0 if not yet known
+ */
+
+
+gdouble pll_frequency(const struct pll *pll)
+{
+	return pll->dt > 0 ? (gdouble) GST_SECOND / pll->dt : 0.0;
+}
+
+
+/*
+ * in periods
+ */
+
+
+gdouble pll_phase_error_rms(const struct pll *pll)
+{
+	return pll->samples ? sqrt(pll->error_sum_sq / pll->samples) : 0.0;
+}
+
+
+/*
+ * number of samples the loop could not follow since it was reset
+ */
+
+
+guint64 pll_faults(const struct pll *pll)
+{
+	return pll->faults;
+}
+
+
+/*
+ * PLL_HISTOGRAM_BINS counts of the phase error, the bins spanning -1 to +1
+ * periods.  errors outside that range are counted in the end bins
+ */
+
+
+const guint64 *pll_phase_error_histogram(const struct pll *pll)
+{
+	return pll->histogram;
+}
+
+
+/*
+ * time from the loop being reset or losing lock to its most recent lock,
+ * GST_CLOCK_TIME_NONE if it has not locked
+ */
+
+
+GstClockTime pll_lock_time(const struct pll *pll)
+{
+	return pll->lock_time;
+}
+
+
+/*
+ * factor by which the gains currently exceed their configured values
+ */
+
+
+gdouble pll_boost(const struct pll *pll)
+{
+	return pll->boost;
+}
@@ -0,0 +1,124 @@
+/*
+ * Software sample clock recovery
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __PLL_H__
+#define __PLL_H__
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+#define PLL_DEFAULT_PHASE_GAIN (1.0 / 128)
+#define PLL_DEFAULT_FREQUENCY_GAIN (1.0 / 1024)
+#define PLL_DEFAULT_LOCK_THRESHOLD 0.25	/* periods */
+#define PLL_DEFAULT_UNLOCK_THRESHOLD 0.5	/* periods */
+#define PLL_DEFAULT_LOCK_COUNT 8	/* samples */
+#define PLL_DEFAULT_BOOST_DECAY 0.98	/* per sample, once locked */
+#define PLL_HISTOGRAM_BINS 32	/* phase error histogram spans +/- 1 period */
+
+
+/*
+ * ============================================================================
+ *
+ *                                    Type
+ *
+ * ============================================================================
+ */
+
+
+struct pll {
+	/*
+	 * loop configuration.  gains are the fractions of each phase
+	 * error applied to the phase and to the period
+	 */
+
+	gdouble phase_gain;
+	gdouble frequency_gain;
+	gdouble lock_threshold, unlock_threshold;
+	guint lock_count;
+	gdouble acquisition_boost;	/* gain multiplier while unlocked */
+	gdouble boost_decay;
+
+	/*
+	 * loop state
+	 */
+
+	GstClockTime t;
+	GstClockTimeDiff dt;
+	gboolean locked;
+	guint in_threshold;	/* consecutive samples within lock_threshold */
+	gdouble boost;		/* current gain multiplier */
+
+	/*
+	 * statistics
+	 */
+
+	guint64 samples;
+	guint64 faults;	/* samples the loop could not follow */
+	gdouble error_sum_sq;	/* periods^2 */
+	guint64 histogram[PLL_HISTOGRAM_BINS];
+	GstClockTime t_unlocked;	/* when lock was last lost, or reset */
+	GstClockTime lock_time;	/* duration of last acquisition */
+};
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+struct pll *pll_new(gdouble phase_gain, gdouble frequency_gain);
+void pll_free(struct pll *pll);
+void pll_reset(struct pll *pll);
+void pll_set_period(struct pll *pll, GstClockTimeDiff dt);
+void pll_set_acquisition_boost(struct pll *pll, gdouble boost);
+guint64 pll_skip_missing(struct pll *pll, GstClockTime t);
+GstClockTime pll_correct(struct pll *pll, GstClockTime t, gboolean *locked);
+GstClockTimeDiff pll_period(const struct pll *pll);
+gdouble pll_frequency(const struct pll *pll);
+gdouble pll_phase_error_rms(const struct pll *pll);
+guint64 pll_faults(const struct pll *pll);
+const guint64 *pll_phase_error_histogram(const struct pll *pll);
+GstClockTime pll_lock_time(const struct pll *pll);
+gdouble pll_boost(const struct pll *pll);
+
+
+G_END_DECLS
+
+
+#endif	/* __PLL_H__ */
@@ -0,0 +1,75 @@
+/*
+ * Settling-time reports for resamplers
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * the resamplers report a change of sample rate mid-stream the same way:
+ * the element's settling-time property is set to the length of output
+ * affected by the change, and a "settling" element message with
+ * "timestamp" and "duration" fields is posted on the bus.  what makes
+ * that output unreliable is up to each element and is documented there.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+#include <gst/gst.h>
+
+
+#include <settling.h>
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+/*
+ * set *settling_time, which is guarded by the element's object lock, to
+ * duration, and post the "settling" message.  the debug message goes to
+ * the element's own category.
+ */
+
+
+void settling_post(GstElement *element, GstDebugCategory *category, GstClockTime *settling_time, GstClockTime timestamp, GstClockTime duration)
+{
+	GST_OBJECT_LOCK(element);
+	*settling_time = duration;
+	GST_OBJECT_UNLOCK(element);
+
+	GST_CAT_DEBUG_OBJECT(category, element, "rate changed at %" GST_TIME_FORMAT ", settling time %" GST_TIME_FORMAT, GST_TIME_ARGS(timestamp), GST_TIME_ARGS(duration));
+	gst_element_post_message(element, gst_message_new_element(GST_OBJECT(element), gst_structure_new("settling",
+		"timestamp", G_TYPE_UINT64, timestamp,
+		"duration", G_TYPE_UINT64, duration,
+		NULL
+	)));
+}
@@ -0,0 +1,433 @@
+/*
+ * GstVideoDecimate
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * reduces the resolution of an RGB video stream by an integer factor by
+ * averaging factor x factor blocks of pixels (a box filter), optionally
+ * converting the result to grayscale.  this is intended for the face
+ * detection branch of the pipeline:  the Haar and LBP cascades do not need
+ * full resolution, and their cost scales with the number of pixels.  the
+ * face geometry reported by the detector must be multiplied by the factor
+ * to map it back to full-resolution coordinates.
+ */
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <string.h>
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include <gst/video/video.h>
+
+
+#include <videodecimate.h>
+
+
+#define DEFAULT_FACTOR 4
+#define MAX_FACTOR 16	/* 255 * MAX_FACTOR must fit in guint16 */
+
+
+/*
+ * ============================================================================
+ *
+ *                                Boilerplate
+ *
+ * ============================================================================
+ */
+
+
+#define GST_CAT_DEFAULT gst_video_decimate_debug
+GST_DEBUG_CATEGORY_STATIC(GST_CAT_DEFAULT);
+
+
+static void additional_initializations(void)
+{
+	GST_DEBUG_CATEGORY_INIT(GST_CAT_DEFAULT, "videodecimate", 0, "videodecimate element");
+}
+
+
+G_DEFINE_TYPE_WITH_CODE(GstVideoDecimate, gst_video_decimate, GST_TYPE_BASE_TRANSFORM, additional_initializations(););
+
+
+/*
+ * ============================================================================
+ *
+ *                             Internal Functions
+ *
+ * ============================================================================
+ */
+
+
+/*
+ * translate a width or height field between the sink and source pads.
+ * going downstream the size is divided by the factor (the partial block
+ * at the right and bottom edges is discarded), going upstream any of the
+ * factor input sizes that map to the given output size is allowed.
+ */
+
+
+static void transform_dimension(GstStructure *s, const gchar *name, gint factor, GstPadDirection direction)
+{
+	const GValue *value = gst_structure_get_value(s, name);
+	gint min = 1, max = G_MAXINT;
+
+	if(value && G_VALUE_HOLDS_INT(value))
+		min = max = g_value_get_int(value);
+	else if(value && GST_VALUE_HOLDS_INT_RANGE(value)) {
+		min = gst_value_get_int_range_min(value);
+		max = gst_value_get_int_range_max(value);
+	}
+
+	switch(direction) {
+	case GST_PAD_SINK:
+		min = MAX(min / factor, 1);
+		max = MAX(max / factor, 1);
+		break;
+
+	case GST_PAD_SRC:
+		min = min > G_MAXINT / factor ? G_MAXINT : min * factor;
+		max = max > G_MAXINT / factor - 1 ? G_MAXINT : max * factor + factor - 1;
+		break;
+
+	default:
+		g_assert_not_reached();
+		break;
+	}
+
+	if(min == max)
+		gst_structure_set(s, name, G_TYPE_INT, min, NULL);
+	else
+		gst_structure_set(s, name, GST_TYPE_INT_RANGE, min, max, NULL);
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                          GstBaseTransform Methods
+ *
+ * ============================================================================
+ */
+
+
+static gboolean get_unit_size(GstBaseTransform *trans, GstCaps *caps, gsize *size)
+{
+	GstVideoInfo info;
+	gboolean success = gst_video_info_from_caps(&info, caps);
+
+	if(success)
+		*size = GST_VIDEO_INFO_SIZE(&info);
+	else
+		GST_ERROR_OBJECT(trans, "could not parse caps %" GST_PTR_FORMAT, caps);
+
+	return success;
+}
+
+
+static GstCaps *transform_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+{
+	GstVideoDecimate *element = GST_VIDEO_DECIMATE(trans);
+	GstCaps *othercaps = gst_caps_new_empty();
+	gint factor;
+	guint i;
+
+	GST_OBJECT_LOCK(element);
+	factor = element->factor;
+	GST_OBJECT_UNLOCK(element);
+
+	/*
+	 * width and height are scaled by the decimation factor.  the
+	 * source pad can carry RGB or grayscale, the sink pad only RGB.
+	 * RGB is listed first so that it is preferred.
+	 */
+
+	for(i = 0; i < gst_caps_get_size(caps); i++) {
+		GstStructure *s = gst_structure_copy(gst_caps_get_structure(caps, i));
+
+		transform_dimension(s, "width", factor, direction);
+		transform_dimension(s, "height", factor, direction);
+		gst_structure_set(s, "format", G_TYPE_STRING, "RGB", NULL);
+		if(direction == GST_PAD_SINK) {
+			GstStructure *gray = gst_structure_copy(s);
+			gst_structure_set(gray, "format", G_TYPE_STRING, "GRAY8", NULL);
+			gst_caps_append_structure(othercaps, s);
+			gst_caps_append_structure(othercaps, gray);
+		} else
+			gst_caps_append_structure(othercaps, s);
+	}
+
+	if(filter) {
+		caps = othercaps;
+		othercaps = gst_caps_intersect_full(filter, othercaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(caps);
+	}
+
+	GST_DEBUG_OBJECT(trans, "transformed to %" GST_PTR_FORMAT, othercaps);
+
+	return othercaps;
+}
+
+
+static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps)
+{
+	GstVideoDecimate *element = GST_VIDEO_DECIMATE(trans);
+	GstVideoInfo ininfo, outinfo;
+	gboolean success = TRUE;
+
+	success &= gst_video_info_from_caps(&ininfo, incaps);
+	success &= gst_video_info_from_caps(&outinfo, outcaps);
+
+	if(success) {
+		element->in_width = GST_VIDEO_INFO_WIDTH(&ininfo);
+		element->in_height = GST_VIDEO_INFO_HEIGHT(&ininfo);
+		element->in_stride = GST_VIDEO_INFO_PLANE_STRIDE(&ininfo, 0);
+		element->out_width = GST_VIDEO_INFO_WIDTH(&outinfo);
+		element->out_height = GST_VIDEO_INFO_HEIGHT(&outinfo);
+		element->out_stride = GST_VIDEO_INFO_PLANE_STRIDE(&outinfo, 0);
+		element->out_gray = GST_VIDEO_INFO_FORMAT(&outinfo) == GST_VIDEO_FORMAT_GRAY8;
+		element->block = element->in_width / element->out_width;
+		if(element->block < 1 || element->block > MAX_FACTOR || element->in_height / element->out_height != element->block) {
+			GST_ERROR_OBJECT(element, "cannot decimate %dx%d to %dx%d", element->in_width, element->in_height, element->out_width, element->out_height);
+			success = FALSE;
+		} else {
+			element->row_sums = g_realloc_n(element->row_sums, 3 * element->out_width * element->block, sizeof(*element->row_sums));
+			GST_DEBUG_OBJECT(element, "decimating %dx%d to %dx%d %s", element->in_width, element->in_height, element->out_width, element->out_height, element->out_gray ? "GRAY8" : "RGB");
+		}
+	} else
+		GST_ERROR_OBJECT(element, "could not parse caps");
+
+	return success;
+}
+
+
+static GstFlowReturn transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuffer *outbuf)
+{
+	GstVideoDecimate *element = GST_VIDEO_DECIMATE(trans);
+	const gint block = element->block;
+	const guint32 area = block * block;
+	const gint n = 3 * element->out_width * block;	/* bytes used from each input row */
+	guint16 *sums = element->row_sums;
+	GstMapInfo srcmap, dstmap;
+	gint x, y, i, j;
+
+	g_return_val_if_fail(sums != NULL, GST_FLOW_ERROR);
+
+	gst_buffer_map(inbuf, &srcmap, GST_MAP_READ);
+	gst_buffer_map(outbuf, &dstmap, GST_MAP_WRITE);
+
+	for(y = 0; y < element->out_height; y++) {
+		const guchar *in = srcmap.data + y * block * element->in_stride;
+		guchar *out = dstmap.data + y * element->out_stride;
+
+		/*
+		 * sum block rows of input.  the inner loop has no
+		 * dependencies between iterations, and is written so the
+		 * compiler can vectorize it
+		 */
+
+		memset(sums, 0, n * sizeof(*sums));
+		for(i = 0; i < block; i++, in += element->in_stride)
+			for(j = 0; j < n; j++)
+				sums[j] += in[j];
+
+		/*
+		 * sum block columns, normalize with rounding, and convert to
+		 * grayscale if requested (ITU-R BT.601 luma weights in
+		 * 8-bit fixed point)
+		 */
+
+		for(x = 0; x < element->out_width; x++) {
+			const guint16 *sum = sums + 3 * x * block;
+			guint32 r = 0, g = 0, b = 0;
+			for(i = 0; i < block; i++, sum += 3) {
+				r += sum[0];
+				g += sum[1];
+				b += sum[2];
+			}
+			r = (r + area / 2) / area;
+			g = (g + area / 2) / area;
+			b = (b + area / 2) / area;
+			if(element->out_gray)
+				*out++ = (77 * r + 150 * g + 29 * b + 128) >> 8;
+			else {
+				*out++ = r;
+				*out++ = g;
+				*out++ = b;
+			}
+		}
+	}
+
+	gst_buffer_unmap(outbuf, &dstmap);
+	gst_buffer_unmap(inbuf, &srcmap);
+
+	return GST_FLOW_OK;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                              GObject Methods
+ *
+ * ============================================================================
+ */
+
+
+enum property {
+	ARG_FACTOR = 1,
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstVideoDecimate *element = GST_VIDEO_DECIMATE(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_FACTOR:
+		element->factor = g_value_get_int(value);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+
+	/* new factor takes effect at the next caps negotiation */
+	gst_base_transform_reconfigure_src(GST_BASE_TRANSFORM(element));
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstVideoDecimate *element = GST_VIDEO_DECIMATE(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_FACTOR:
+		g_value_set_int(value, element->factor);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
+static void finalize(GObject *object)
+{
+	GstVideoDecimate *element = GST_VIDEO_DECIMATE(object);
+
+	g_free(element->row_sums);
+	element->row_sums = NULL;
+
+	/*
+	 * chain to parent class' finalize() method
+	 */
+
+	G_OBJECT_CLASS(gst_video_decimate_parent_class)->finalize(object);
+}
+
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SINK_NAME,
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		GST_VIDEO_CAPS_MAKE("RGB")
+	)
+);
+
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
+	GST_BASE_TRANSFORM_SRC_NAME,
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS(
+		GST_VIDEO_CAPS_MAKE("{ RGB, GRAY8 }")
+	)
+);
+
+
+static void gst_video_decimate_class_init(GstVideoDecimateClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->set_property = GST_DEBUG_FUNCPTR(set_property);
+	gobject_class->get_property = GST_DEBUG_FUNCPTR(get_property);
+	gobject_class->finalize = GST_DEBUG_FUNCPTR(finalize);
+
+	transform_class->get_unit_size = GST_DEBUG_FUNCPTR(get_unit_size);
+	transform_class->transform_caps = GST_DEBUG_FUNCPTR(transform_caps);
+	transform_class->set_caps = GST_DEBUG_FUNCPTR(set_caps);
+	transform_class->transform = GST_DEBUG_FUNCPTR(transform);
+	transform_class->passthrough_on_same_caps = TRUE;
+
+	gst_element_class_set_details_simple(element_class,
+		"Video decimator",
+		"Filter/Converter/Video/Scaler",
+		"Reduces video resolution by an integer factor with a box filter, optionally converting to grayscale.",
+		"Kipp Cannon <kipp.cannon@ligo.org>"
+	);
+
+	g_object_class_install_property(
+		gobject_class,
+		ARG_FACTOR,
+		g_param_spec_int(
+			"factor",
+			"factor",
+			"Decimation factor.  Width and height are both reduced by this factor.",
+			1, MAX_FACTOR, DEFAULT_FACTOR,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
+}
+
+
+static void gst_video_decimate_init(GstVideoDecimate *element)
+{
+	gst_base_transform_set_gap_aware(GST_BASE_TRANSFORM(element), TRUE);
+
+	element->block = 0;
+	element->row_sums = NULL;
+}
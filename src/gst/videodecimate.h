@@ -0,0 +1,110 @@
+/*
+ * GstVideoDecimate
+ *
+ * Copyright (C) 2014  Kipp Cannon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __VIDEO_DECIMATE_H__
+#define __VIDEO_DECIMATE_H__
+
+
+/*
+ * ============================================================================
+ *
+ *                                  Preamble
+ *
+ * ============================================================================
+ */
+
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+
+G_BEGIN_DECLS
+
+
+/*
+ * ============================================================================
+ *
+ *                                    Type
+ *
+ * ============================================================================
+ */
+
+
+#define GST_TYPE_VIDEO_DECIMATE \
+	(gst_video_decimate_get_type())
+#define GST_VIDEO_DECIMATE(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_VIDEO_DECIMATE, GstVideoDecimate))
+#define GST_VIDEO_DECIMATE_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_VIDEO_DECIMATE, GstVideoDecimateClass))
+#define GST_VIDEO_DECIMATE_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_VIDEO_DECIMATE, GstVideoDecimateClass))
+#define GST_IS_VIDEO_DECIMATE(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_VIDEO_DECIMATE))
+#define GST_IS_VIDEO_DECIMATE_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_VIDEO_DECIMATE))
+
+
+typedef struct _GstVideoDecimateClass GstVideoDecimateClass;
+typedef struct _GstVideoDecimate GstVideoDecimate;
+
+
+struct _GstVideoDecimateClass {
+	GstBaseTransformClass parent_class;
+};
+
+
+/**
+ * GstVideoDecimate
+ */
+
+
+struct _GstVideoDecimate {
+	GstBaseTransform basetransform;
+
+	gint factor;
+
+	gint block;	/* negotiated decimation factor */
+	gint in_width, in_height;	/* pixels */
+	gint in_stride;	/* bytes */
+	gint out_width, out_height;	/* pixels */
+	gint out_stride;	/* bytes */
+	gboolean out_gray;
+	guint16 *row_sums;
+};
+
+
+/*
+ * ============================================================================
+ *
+ *                                Exported API
+ *
+ * ============================================================================
+ */
+
+
+GType gst_video_decimate_get_type(void);
+
+
+G_END_DECLS
+
+
+#endif	/* __VIDEO_DECIMATE_H__ */
@@ -28,6 +28,9 @@
  */
 
 
+#include <math.h>
+
+
 #include <glib.h>
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
@@ -37,6 +40,9 @@
 #include <videoratefaker.h>
 
 
+#define DEFAULT_AUTO FALSE
+
+
 /*
  * ============================================================================
  *
@@ -97,6 +103,74 @@ static gboolean do_new_segment(GstVideoRateFaker *element)
 }
 
 
+/*
+ * automatic frame rate estimation.  each frame's index is advanced from
+ * the previous frame's by the number of frame periods, at least 1, that
+ * best matches the gap between their timestamps, so dropped frames do not
+ * bias the estimate.  the timestamp is then added to a running
+ * least-squares fit of timestamp against index, and replaced with the
+ * fitted line's value at that index.
+ */
+
+
+static void reset_fit(GstVideoRateFaker *element)
+{
+	element->t_origin = GST_CLOCK_TIME_NONE;
+	element->last_pts = GST_CLOCK_TIME_NONE;
+	element->index = 0;
+	element->count = 0;
+	element->mean_n = element->mean_t = 0.0;
+	element->c_nn = element->c_nt = element->c_tt = 0.0;
+	element->period = element->nominal_period;
+	element->period_uncertainty = 0.0;
+}
+
+
+static GstClockTime fit_timestamp(GstVideoRateFaker *element, GstClockTime pts)
+{
+	gdouble n, t, dn, dt;
+
+	if(!GST_CLOCK_TIME_IS_VALID(element->t_origin)) {
+		element->t_origin = pts;
+		element->index = 0;
+	} else if(pts <= element->last_pts)
+		/* duplicate or out-of-order:  keep it on the grid */
+		element->index++;
+	else if(element->period > 0.0)
+		element->index += MAX(1, (guint64) llround((pts - element->last_pts) / (element->period * GST_SECOND)));
+	else {
+		/* rate not yet known:  assume consecutive */
+		element->period = (gdouble) (pts - element->last_pts) / GST_SECOND;
+		element->index++;
+	}
+	element->last_pts = pts;
+
+	/* update the fit */
+	n = element->index;
+	t = (gdouble) (gint64) (pts - element->t_origin) / GST_SECOND;
+	element->count++;
+	dn = n - element->mean_n;
+	element->mean_n += dn / element->count;
+	dt = t - element->mean_t;
+	element->mean_t += dt / element->count;
+	element->c_nn += dn * (n - element->mean_n);
+	element->c_nt += dn * (t - element->mean_t);
+	element->c_tt += dt * (t - element->mean_t);
+
+	if(element->count >= 2 && element->c_nn > 0.0) {
+		element->period = element->c_nt / element->c_nn;
+		if(element->count >= 3) {
+			gdouble ssr = MAX(element->c_tt - element->c_nt * element->period, 0.0);
+			element->period_uncertainty = sqrt(ssr / (element->count - 2) / element->c_nn);
+		}
+		t = element->mean_t + element->period * (n - element->mean_n);
+	} else
+		t = element->period * n;
+
+	return element->t_origin + (GstClockTimeDiff) llround(t * GST_SECOND);
+}
+
+
 /*
  * ============================================================================
  *
@@ -149,6 +223,19 @@ static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outc
 	success &= gst_structure_get_fraction(gst_caps_get_structure(outcaps, 0), "framerate", &outrate_num, &outrate_den);
 
 	if(success) {
+		gboolean auto_rate;
+
+		GST_OBJECT_LOCK(element);
+		element->nominal_period = inrate_num > 0 ? (gdouble) inrate_den / inrate_num : 0.0;
+		if(!element->count)
+			element->period = element->nominal_period;
+		auto_rate = element->auto_rate;
+		GST_OBJECT_UNLOCK(element);
+
+		/* timestamps must be rewritten even if caps are unchanged */
+		if(auto_rate)
+			gst_base_transform_set_passthrough(trans, FALSE);
+
 		gst_util_fraction_multiply(inrate_num, inrate_den, outrate_den, outrate_num, &element->inrate_over_outrate_num, &element->inrate_over_outrate_den);
 		GST_DEBUG_OBJECT(element, "in rate / out rate = %d/%d", element->inrate_over_outrate_num, element->inrate_over_outrate_den);
 		do_new_segment(element);
@@ -159,12 +246,31 @@ static gboolean set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outc
 }
 
 
+static gboolean start(GstBaseTransform *trans)
+{
+	GstVideoRateFaker *element = GST_VIDEO_RATE_FAKER(trans);
+
+	GST_OBJECT_LOCK(element);
+	reset_fit(element);
+	GST_OBJECT_UNLOCK(element);
+
+	return TRUE;
+}
+
+
 static gboolean sink_event(GstBaseTransform *trans, GstEvent *event)
 {
 	GstVideoRateFaker *element = GST_VIDEO_RATE_FAKER(trans);
 	gboolean success = TRUE;
 
 	switch(GST_EVENT_TYPE(event)) {
+	case GST_EVENT_FLUSH_STOP:
+		GST_OBJECT_LOCK(element);
+		reset_fit(element);
+		GST_OBJECT_UNLOCK(element);
+		success = GST_BASE_TRANSFORM_CLASS(gst_video_rate_faker_parent_class)->sink_event(trans, event);
+		break;
+
 	case GST_EVENT_SEGMENT:
 		if(element->last_segment)
 			gst_event_unref(element->last_segment);
@@ -189,6 +295,15 @@ static GstFlowReturn transform_ip(GstBaseTransform *trans, GstBuffer *buf)
 	if(element->need_new_segment)
 		do_new_segment(element);
 
+	GST_OBJECT_LOCK(element);
+	if(element->auto_rate && GST_BUFFER_PTS_IS_VALID(buf)) {
+		GST_BUFFER_PTS(buf) = fit_timestamp(element, GST_BUFFER_PTS(buf));
+		if(element->period > 0.0)
+			GST_BUFFER_DURATION(buf) = llround(element->period * GST_SECOND);
+		GST_LOG_OBJECT(element, "frame %" G_GUINT64_FORMAT ":  period %.9g +/- %.3g s", element->index, element->period, element->period_uncertainty);
+	}
+	GST_OBJECT_UNLOCK(element);
+
 	if(GST_BUFFER_PTS_IS_VALID(buf) && GST_BUFFER_DURATION_IS_VALID(buf)) {
 		GstClockTime timestamp = GST_BUFFER_PTS(buf);
 		GstClockTime duration = GST_BUFFER_DURATION(buf);
@@ -215,6 +330,64 @@ static GstFlowReturn transform_ip(GstBaseTransform *trans, GstBuffer *buf)
  */
 
 
+enum property {
+	ARG_AUTO = 1,
+	ARG_FRAMERATE_ESTIMATE,
+	ARG_FRAMERATE_UNCERTAINTY,
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstVideoRateFaker *element = GST_VIDEO_RATE_FAKER(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_AUTO:
+		element->auto_rate = g_value_get_boolean(value);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+
+	/* pass-through mode is re-evaluated at the next caps negotiation */
+	gst_base_transform_reconfigure_src(GST_BASE_TRANSFORM(element));
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstVideoRateFaker *element = GST_VIDEO_RATE_FAKER(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_AUTO:
+		g_value_set_boolean(value, element->auto_rate);
+		break;
+
+	case ARG_FRAMERATE_ESTIMATE:
+		g_value_set_double(value, element->period > 0.0 ? 1.0 / element->period : 0.0);
+		break;
+
+	case ARG_FRAMERATE_UNCERTAINTY:
+		g_value_set_double(value, element->period > 0.0 ? element->period_uncertainty / (element->period * element->period) : 0.0);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(element);
+}
+
+
 static void finalize(GObject *object)
 {
 	GstVideoRateFaker *element = GST_VIDEO_RATE_FAKER(object);
@@ -257,10 +430,13 @@ static void gst_video_rate_faker_class_init(GstVideoRateFakerClass *klass)
 	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
 	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
 
+	object_class->set_property = GST_DEBUG_FUNCPTR(set_property);
+	object_class->get_property = GST_DEBUG_FUNCPTR(get_property);
 	object_class->finalize = GST_DEBUG_FUNCPTR(finalize);
 
 	transform_class->transform_caps = GST_DEBUG_FUNCPTR(transform_caps);
 	transform_class->set_caps = GST_DEBUG_FUNCPTR(set_caps);
+	transform_class->start = GST_DEBUG_FUNCPTR(start);
 	transform_class->sink_event = GST_DEBUG_FUNCPTR(sink_event);
 	transform_class->transform_ip = GST_DEBUG_FUNCPTR(transform_ip);
 	transform_class->passthrough_on_same_caps = TRUE;
@@ -268,10 +444,46 @@ static void gst_video_rate_faker_class_init(GstVideoRateFakerClass *klass)
 	gst_element_class_set_details_simple(element_class, 
 		"Video rate faker",
 		"Filter/Video",
-		"Adjusts segments and video buffer metadata to assign a new frame rate.",
+		"Adjusts segments and video buffer metadata to assign a new frame rate, or to place frames on a uniform grid at the frame rate measured from their timestamps.",
 		"Kipp Cannon <kipp.cannon@ligo.org>"
 	);
 
+	g_object_class_install_property(
+		object_class,
+		ARG_AUTO,
+		g_param_spec_boolean(
+			"auto",
+			"Automatic frame rate",
+			"Measure the true frame rate with a running least-squares fit of the input timestamps against frame number, and replace the timestamps with the fitted uniform grid.  Dropped frames are detected from the gaps between timestamps and do not bias the fit.  The caps continue to report the nominal rate.",
+			DEFAULT_AUTO,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_FRAMERATE_ESTIMATE,
+		g_param_spec_double(
+			"framerate-estimate",
+			"Frame rate estimate",
+			"Frame rate measured in auto mode (Hz).",
+			0, G_MAXDOUBLE, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_FRAMERATE_UNCERTAINTY,
+		g_param_spec_double(
+			"framerate-uncertainty",
+			"Frame rate uncertainty",
+			"1 sigma uncertainty of framerate-estimate from the scatter of the timestamps about the fit (Hz).",
+			0, G_MAXDOUBLE, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
 	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_factory));
 	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_factory));
 }
@@ -285,4 +497,6 @@ static void gst_video_rate_faker_init(GstVideoRateFaker *element)
 	element->last_segment = NULL;
 	element->inrate_over_outrate_num = -1;
 	element->inrate_over_outrate_den = -1;
+	element->nominal_period = 0.0;
+	reset_fit(element);
 }
@@ -85,6 +85,22 @@ struct _GstVideoRateFaker {
 
 	gint inrate_over_outrate_num;
 	gint inrate_over_outrate_den;
+
+	/*
+	 * automatic frame rate estimation.  running least-squares fit of
+	 * timestamp (seconds since t_origin) against frame index, kept as
+	 * means and centred co-moments for numerical stability
+	 */
+
+	gboolean auto_rate;
+	gdouble nominal_period;	/* s, from caps, 0 if unknown */
+	GstClockTime t_origin;
+	GstClockTime last_pts;
+	guint64 index;
+	guint64 count;
+	gdouble mean_n, mean_t;
+	gdouble c_nn, c_nt, c_tt;
+	gdouble period, period_uncertainty;	/* s */
 };
 
 
@@ -31,6 +31,13 @@
  * reconstruct the true time of each sample.  after reclocking, the samples
  * are interpolated onto a time series having an integer sample rate (for
  * compatibility with gstreamer) using a windowed sinc kernel.
+ *
+ * the raw USB packets can be recorded together with their times of
+ * arrival, and the element can replay such a recording or synthesize
+ * packets from a model photoplethysmograph in place of the device.  either
+ * way the packets are fed through the same parser, PLL and interpolator as
+ * the device's, at the recorded pace or as fast as the pipeline will take
+ * them.
  */
 
 
@@ -43,8 +50,9 @@
  */
 
 
+#include <errno.h>
 #include <math.h>
-#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 
 
@@ -57,6 +65,7 @@
 #include <gst/base/gstbasesrc.h>
 
 
+#include <pll.h>
 #include <wilddevine.h>
 
 
@@ -65,25 +74,53 @@
 #define WILDDEVINE_INTERFACE 0
 #define WILDDEVINE_ENDPOINT 0x81
 #define WILDDEVINE_TIMEOUT 80		/* milliseconds */
+#define WILDDEVINE_PACKET_SIZE 8	/* bytes */
+#define NUM_TRANSFERS 4			/* kept in flight */
+#define RECONNECT_INTERVAL (1 * GST_SECOND)	/* look for a lost device this often */
+#define PLL_ACQUISITION_BOOST 8.0	/* PLL gain multiplier until locked */
+#define DEFAULT_TELEMETRY_INTERVAL GST_SECOND
 
 
-#define RATE 40				/* Hertz */
+#define DEVICE_RATE 29.78805087		/* Hertz, approximate */
+#define DEFAULT_RATE 40			/* Hertz */
 #define UNIT_SIZE (2*sizeof(float))	/* bytes (2 floats) */
-#define KERNEL_LENGTH 16		/* samples.  should be even */
+#define DEFAULT_KERNEL_LENGTH 16	/* samples */
+#define MAX_KERNEL_LENGTH 256		/* samples.  must be < RING_SIZE */
+#define DEFAULT_LOW_LATENCY FALSE
+#define KERNEL_PHASES 512		/* kernel table resolution, per sample */
+#define RING_SIZE 1024			/* samples.  must be a power of 2 */
+#define RING_HEADROOM 0.9		/* fraction of the ring a buffer may span */
+#define DEFAULT_RECORD_LOCATION NULL
+#define DEFAULT_REPLAY_LOCATION NULL
+#define DEFAULT_REPLAY_FAST FALSE
+#define DEFAULT_SYNTHESIZE FALSE
+#define DEFAULT_DEVICE_PATH NULL
+#define DEFAULT_DEVICE_SERIAL NULL
 
 
-#undef PLL_DEBUG			/* dump PLL debug info */
-#ifdef PLL_DEBUG
-#include <stdio.h>
-#endif
+/*
+ * raw packet recording file format.  the magic string and a guint32
+ * format version, followed by one record per USB packet:
+ *
+ *	guint64 time of arrival (ns)
+ *	guint8 packet[WILDDEVINE_PACKET_SIZE]
+ *
+ * all in host byte order.
+ */
 
 
-struct queued_sample {
-	GstClockTime t;
-	GstClockTimeDiff dt;
-	gfloat scl;
-	gfloat ppg;
-};
+#define RAW_FILE_MAGIC "WILDDEVR"
+#define RAW_FILE_VERSION 1
+
+
+/*
+ * model photoplethysmograph for synthesized packets
+ */
+
+
+#define SYNTH_HEART_RATE 1.2		/* Hertz */
+#define SYNTH_BREATHING_RATE 0.25	/* Hertz */
+#define SYNTH_SEED 20140101		/* arrival-time jitter is reproducible */
 
 
 /*
@@ -118,518 +155,1804 @@ G_DEFINE_TYPE_WITH_CODE(GstWildDevine, gst_wilddevine, GST_TYPE_BASE_SRC, additi
 
 
 /*
- * sample clock PLL
+ * incremental parser for the device's serial protocol.  the device sends
+ * a stream of records of the form
+ *
+ *	<VER>hex<\VER>
+ *	<SER>hex<\SER>
+ *	<RAW>hhhh hhhh<\RAW>
+ *
+ * split arbitrarily across USB packets.  bytes are fed to the parser one
+ * at a time, hex fields are decoded as they arrive, and a complete record
+ * is reported when its closing tag's final byte is seen.  a byte that
+ * does not fit the grammar abandons the current record;  if it is '<' it
+ * is taken as the start of the next one.
  */
 
 
-struct pll {
-	GstClockTime t;
-	GstClockTimeDiff dt;
+enum parser_tag {
+	TAG_NONE = 0,
+	TAG_VER,
+	TAG_SER,
+	TAG_RAW
 };
 
 
-static struct pll *pll_new(void)
+static const char tag_names[][4] = {"", "VER", "SER", "RAW"};
+
+
+enum parser_state {
+	PARSE_IDLE,	/* waiting for '<' */
+	PARSE_OPEN,	/* reading tag name and '>' */
+	PARSE_FIELD,	/* reading hex fields */
+	PARSE_CLOSE	/* reading "<\TAG>" */
+};
+
+
+struct parser {
+	enum parser_state state;
+	enum parser_tag tag;
+	char name[3];
+	gint n;		/* bytes consumed in current state */
+	gint field;	/* index of current field */
+	gint digits;	/* digits read in current field */
+	guint64 value[2];
+};
+
+
+static void parser_init(struct parser *parser)
 {
-	struct pll *pll = g_new(struct pll, 1);
+	parser->state = PARSE_IDLE;
+	parser->tag = TAG_NONE;
+	parser->n = 0;
+}
 
-	pll->t = GST_CLOCK_TIME_NONE;
-	pll->dt = 0;
 
-	return pll;
+static gint hex_digit(guchar c)
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
 }
 
 
-static void pll_free(struct pll *pll)
+/*
+ * feed one byte to the parser.  returns the tag of the record it
+ * completes, or TAG_NONE.  the record's fields are in parser->value[]
+ */
+
+
+static enum parser_tag parser_push(struct parser *parser, guchar c)
 {
-	g_free(pll);
+	gint d;
+
+	switch(parser->state) {
+	case PARSE_IDLE:
+		if(c == '<') {
+			parser->state = PARSE_OPEN;
+			parser->n = 0;
+		}
+		return TAG_NONE;
+
+	case PARSE_OPEN:
+		if(parser->n < 3) {
+			if(c == '<')
+				goto resync;
+			parser->name[parser->n++] = c;
+			return TAG_NONE;
+		}
+		if(c != '>')
+			goto resync;
+		for(parser->tag = TAG_VER; parser->tag <= TAG_RAW; parser->tag++)
+			if(!memcmp(parser->name, tag_names[parser->tag], 3))
+				break;
+		if(parser->tag > TAG_RAW)
+			goto resync;
+		parser->state = PARSE_FIELD;
+		parser->field = 0;
+		parser->digits = 0;
+		parser->value[0] = parser->value[1] = 0;
+		return TAG_NONE;
+
+	case PARSE_FIELD:
+		d = hex_digit(c);
+		if(d >= 0) {
+			/* RAW fields are 4 digits, others must fit in 64
+			 * bits */
+			if(parser->digits == (parser->tag == TAG_RAW ? 4 : 16))
+				goto resync;
+			parser->value[parser->field] = parser->value[parser->field] << 4 | d;
+			parser->digits++;
+			return TAG_NONE;
+		}
+		if(!parser->digits)
+			goto resync;
+		if(parser->tag == TAG_RAW) {
+			if(parser->digits != 4)
+				goto resync;
+			if(parser->field == 0) {
+				if(c != ' ')
+					goto resync;
+				parser->field = 1;
+				parser->digits = 0;
+				return TAG_NONE;
+			}
+		}
+		if(c != '<')
+			goto resync;
+		parser->state = PARSE_CLOSE;
+		parser->n = 1;
+		return TAG_NONE;
+
+	case PARSE_CLOSE:
+		/* '<' has been consumed.  then '\', the name, and '>' */
+		if(c != (parser->n == 1 ? '\\' : parser->n < 5 ? tag_names[parser->tag][parser->n - 2] : '>'))
+			goto resync;
+		if(++parser->n < 6)
+			return TAG_NONE;
+		parser->state = PARSE_IDLE;
+		return parser->tag;
+	}
+
+resync:
+	parser->state = c == '<' ? PARSE_OPEN : PARSE_IDLE;
+	parser->n = 0;
+	return TAG_NONE;
 }
 
 
-static GstClockTime pll_correct(struct pll *pll, GstClockTime t, gboolean *locked)
+/*
+ * libusb context shared by every instance in the process.  one event
+ * thread services the transfers of all open devices, each transfer's
+ * completion callback delivering its packet to the element that
+ * submitted it.  the context and thread are created when the first
+ * device is opened and torn down when the last is closed.
+ */
+
+
+static struct {
+	GMutex lock;
+	gint refcount;
+	libusb_context *context;
+	GThread *thread;
+	volatile gint running;
+} usb_shared;
+
+
+static gpointer usb_event_thread(gpointer data)
 {
-	GstClockTimeDiff error;
+	while(g_atomic_int_get(&usb_shared.running)) {
+		struct timeval tv = {0, WILDDEVINE_TIMEOUT * 1000};
+		libusb_handle_events_timeout_completed(usb_shared.context, &tv, NULL);
+	}
 
-	g_assert(GST_CLOCK_TIME_IS_VALID(t));
+	return NULL;
+}
 
-	if(!GST_CLOCK_TIME_IS_VALID(pll->t)) {
-		pll->t = t;
-		*locked = FALSE;
-	} else {
-		if(!pll->dt) {
-			g_assert_cmpuint(t, >=, pll->t);
-			pll->dt = t - pll->t;
-		}
-#ifdef PLL_DEBUG
-		fprintf(stderr, "a: %lu %lu %ld\n", t, pll->t, pll->dt);
-#endif
-		pll->t += pll->dt;
 
-		error = GST_CLOCK_DIFF(pll->t, t);	/* t - pll->t */
-		*locked = pll->dt >= 2 * labs(error);
-#ifdef PLL_DEBUG
-		fprintf(stderr, "c: %ld\n", error);
-#endif
+static libusb_context *usb_context_ref(void)
+{
+	libusb_context *context = NULL;
 
-		pll->t += error / 128;
-		pll->dt += error / 1024;
-		g_assert_cmpint(pll->dt, >, 0);
+	g_mutex_lock(&usb_shared.lock);
+	if(!usb_shared.refcount) {
+		if(libusb_init(&usb_shared.context)) {
+			GST_ERROR("libusb_init() failed");
+			goto done;
+		}
+		usb_shared.running = TRUE;
+		usb_shared.thread = g_thread_new("wilddevine-usb", usb_event_thread, NULL);
 	}
+	usb_shared.refcount++;
+	context = usb_shared.context;
+done:
+	g_mutex_unlock(&usb_shared.lock);
 
-	return pll->t;
+	return context;
 }
 
 
-static GstClockTimeDiff pll_period(const struct pll *pll)
+static void usb_context_unref(void)
 {
-	return pll->dt;
+	g_mutex_lock(&usb_shared.lock);
+	if(!--usb_shared.refcount) {
+		g_atomic_int_set(&usb_shared.running, FALSE);
+		g_thread_join(usb_shared.thread);
+		usb_shared.thread = NULL;
+		libusb_exit(usb_shared.context);
+		usb_shared.context = NULL;
+	}
+	g_mutex_unlock(&usb_shared.lock);
 }
 
 
 /*
- * wrapper to retrieve a regex match, parse as base 16 int, and return
- * result.
+ * bus number and port numbers from the root, "bus-port.port.port", as
+ * in sysfs
  */
 
 
-static unsigned long fetch_wilddevine_sample(const GMatchInfo *match_info, gint n)
+static void device_path(libusb_device *device, char *path, size_t size)
 {
-	gchar *s = g_match_info_fetch(match_info, n);
-	unsigned long x = strtol(s, NULL, 16);
-	g_free(s);
-	return x;
+	guint8 ports[7];
+	gint n = libusb_get_port_numbers(device, ports, G_N_ELEMENTS(ports));
+	gint len, i;
+
+	len = g_snprintf(path, size, "%d", libusb_get_bus_number(device));
+	for(i = 0; i < n && (size_t) len < size; i++)
+		len += g_snprintf(path + len, size - len, "%c%d", i ? '.' : '-', ports[i]);
 }
 
 
 /*
- * open WildDevine device
+ * open and claim a WildDevine device.  with neither device-path nor
+ * device-serial set, the first device that can be claimed is used, so
+ * that several instances each find a different device
  */
 
 
 static gboolean open_device(GstWildDevine *element)
 {
 	libusb_device **list;
-	libusb_device *device = NULL;
 	ssize_t n = libusb_get_device_list(element->usb_context, &list);
 	ssize_t i;
 
 	if(n < 0) {
-		GST_ERROR_OBJECT(element, "libusbb_get_devie_list() failed");
-		goto done;
+		GST_ERROR_OBJECT(element, "libusb_get_device_list() failed");
+		return FALSE;
 	}
 
-	for(i = 0; i < n; i++) {
+	for(i = 0; i < n && !element->usb_handle; i++) {
 		struct libusb_device_descriptor desc;
+		libusb_device_handle *handle;
+		unsigned char serial[64] = "";
+		char path[32];
+
 		if(libusb_get_device_descriptor(list[i], &desc)) {
 			GST_ERROR_OBJECT(element, "libusb_get_device_descriptor() failed");
-			goto done;
-		}
-		if(desc.idVendor == WILDDEVINE_VEND_ID && desc.idProduct == WILDDEVINE_PROD_ID) {
-			device = list[i];
 			break;
 		}
-	}
+		if(desc.idVendor != WILDDEVINE_VEND_ID || desc.idProduct != WILDDEVINE_PROD_ID)
+			continue;
+		device_path(list[i], path, sizeof(path));
+		if(element->device_path && strcmp(path, element->device_path))
+			continue;
+
+		if(libusb_open(list[i], &handle)) {
+			GST_WARNING_OBJECT(element, "%s: libusb_open() failed", path);
+			continue;
+		}
 
-	if(!device) {
-		GST_ERROR_OBJECT(element, "device not found");
-		goto done;
-	}
+		/* the USB serial number string descriptor, not the <SER>
+		 * value the device reports in its data stream */
+		if(desc.iSerialNumber && libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, serial, sizeof(serial)) < 0)
+			serial[0] = '\0';
+		if(element->device_serial && (!serial[0] || strcmp((char *) serial, element->device_serial))) {
+			libusb_close(handle);
+			continue;
+		}
 
-	if(libusb_open(device, &element->usb_handle)) {
-		GST_ERROR_OBJECT(element, "libusb_open() failed");
-		device = NULL;
-		goto done;
+		libusb_detach_kernel_driver(handle, WILDDEVINE_INTERFACE);
+		if(libusb_claim_interface(handle, WILDDEVINE_INTERFACE)) {
+			/* probably in use by another instance */
+			GST_DEBUG_OBJECT(element, "%s: libusb_claim_interface() failed", path);
+			libusb_close(handle);
+			continue;
+		}
+
+		GST_INFO_OBJECT(element, "opened device %s, USB serial number \"%s\"", path, serial);
+		element->usb_handle = handle;
 	}
 
-done:
 	libusb_free_device_list(list, 1);
-	return device != NULL;
+	return element->usb_handle != NULL;
 }
 
 
 /*
- * sample collection thread
+ * raw packet recordings
  */
 
 
-static gpointer collect_thread(gpointer _element)
+static gboolean write_raw_header(FILE *file)
 {
-	GstWildDevine *element = GST_WILDDEVINE(_element);
-#if 1
-	GstClock *clock = gst_system_clock_obtain();
-	GstClockTime base_time = gst_clock_get_time(clock);
-#else	/* why doesn't this work!? */
-	GstClock *clock = gst_element_get_clock(GST_ELEMENT(_element));
-	GstClockTime base_time = gst_element_get_base_time(GST_ELEMENT(_element));
-#endif
-	GRegex *raw_pattern, *ser_pattern, *ver_pattern;
-	GString *buffer = g_string_new("");
-	struct pll *pll = pll_new();
+	guint32 version = RAW_FILE_VERSION;
+	gboolean success = TRUE;
 
-	raw_pattern = g_regex_new("<RAW>([[:xdigit:]]{4}) ([[:xdigit:]]{4})<\\\\RAW>", G_REGEX_MULTILINE | G_REGEX_OPTIMIZE, 0, NULL);
-	ser_pattern = g_regex_new("<SER>([[:xdigit:]]+)<\\\\SER>", G_REGEX_MULTILINE | G_REGEX_OPTIMIZE, 0, NULL);
-	ver_pattern = g_regex_new("<VER>([[:xdigit:]]+)<\\\\VER>", G_REGEX_MULTILINE | G_REGEX_OPTIMIZE, 0, NULL);
-	g_assert(raw_pattern && ser_pattern && ver_pattern);
+	success &= fwrite(RAW_FILE_MAGIC, 1, strlen(RAW_FILE_MAGIC), file) == strlen(RAW_FILE_MAGIC);
+	success &= fwrite(&version, sizeof(version), 1, file) == 1;
 
-	while(1) {
-		unsigned char read[8];
-		int n;
-		GstClockTime t;
-		GMatchInfo *match_info;
+	return success;
+}
 
-		if(element->stop_requested) {
-			element->collect_status = GST_FLOW_EOS;
-			break;
-		}
 
-		switch(libusb_interrupt_transfer(element->usb_handle, WILDDEVINE_ENDPOINT, read, sizeof(read), &n, WILDDEVINE_TIMEOUT)) {
-		case 0:
-			/* success */
-			t = gst_clock_get_time(clock) - base_time;
-			if(n != sizeof(read)) {
-				/* ... but bad read size */
-				GST_ERROR_OBJECT(element, "read %d bytes, expected %lu", n, sizeof(read));
-				element->collect_status = GST_FLOW_ERROR;
-				goto done;
-			}
-			break;
+static gboolean read_raw_header(FILE *file)
+{
+	char magic[sizeof(RAW_FILE_MAGIC) - 1];
+	guint32 version;
 
-		case LIBUSB_ERROR_TIMEOUT:
-			/* timeout */
-			GST_ERROR_OBJECT(element, "timeout");
-			element->collect_status = GST_FLOW_ERROR;
-			goto done;
+	if(fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, RAW_FILE_MAGIC, sizeof(magic)))
+		return FALSE;
+	if(fread(&version, sizeof(version), 1, file) != 1 || version != RAW_FILE_VERSION)
+		return FALSE;
 
-		case LIBUSB_ERROR_PIPE:
-			/* transfer was halted */
-			GST_ERROR_OBJECT(element, "transfer halted");
-			element->collect_status = GST_FLOW_EOS;
-			goto done;
+	return TRUE;
+}
 
-		case LIBUSB_ERROR_OVERFLOW:
-			/* too much data arrived */
-			GST_ERROR_OBJECT(element, "transfer overflow");
-			element->collect_status = GST_FLOW_ERROR;
-			goto done;
 
-		case LIBUSB_ERROR_NO_DEVICE:
-			/* device has been unplugged */
-			GST_ERROR_OBJECT(element, "unplugged");
-			element->collect_status = GST_FLOW_EOS;
-			goto done;
+static gboolean write_raw_record(FILE *file, const unsigned char *packet, GstClockTime t)
+{
+	guint64 t64 = t;
+	gboolean success = TRUE;
 
-		default:
-			/* other error */
-			GST_ERROR_OBJECT(element, "unknown error");
-			element->collect_status = GST_FLOW_ERROR;
-			goto done;
-		}
+	success &= fwrite(&t64, sizeof(t64), 1, file) == 1;
+	success &= fwrite(packet, 1, WILDDEVINE_PACKET_SIZE, file) == WILDDEVINE_PACKET_SIZE;
 
-		/* first byte recieved gives number of remaining bytes that
-		 * contain data */
-		g_string_append_len(buffer, (const char *) &read[1], read[0]);
-
-		/* check for version number */
-		g_regex_match(ver_pattern, buffer->str, 0, &match_info);
-		if(g_match_info_matches(match_info)) {
-			guint64 version = fetch_wilddevine_sample(match_info, 1);
-			if(version != element->version) {
-				element->version = version;
-				GST_INFO_OBJECT(element, "version = %lu", element->version);
-				g_object_notify(G_OBJECT(element), "version");
-			}
-		}
-		g_match_info_free(match_info);
-
-		/* check for serial number */
-		g_regex_match(ser_pattern, buffer->str, 0, &match_info);
-		if(g_match_info_matches(match_info)) {
-			guint64 serial = fetch_wilddevine_sample(match_info, 1);
-			if(serial != element->serial) {
-				element->serial = serial;
-				GST_INFO_OBJECT(element, "serial = %lu", element->serial);
-				g_object_notify(G_OBJECT(element), "serial");
-			}
-		}
-		g_match_info_free(match_info);
+	return success;
+}
 
-		/* loop over sample matches, and remove data from buffer */
-		n = 0;
-		g_regex_match(raw_pattern, buffer->str, 0, &match_info);
-		g_mutex_lock(&element->queue_lock);
-		while(g_match_info_matches(match_info)) {
-			struct queued_sample *sample = g_new(struct queued_sample, 1);
-			gboolean locked;
-			sample->t = pll_correct(pll, t, &locked);
-			sample->dt = pll_period(pll);
-			sample->scl = fetch_wilddevine_sample(match_info, 1) / 65536.0;
-			sample->ppg = fetch_wilddevine_sample(match_info, 2) / 65536.0;
-
-			g_match_info_fetch_pos(match_info, 0, NULL, &n);
-			g_match_info_next(match_info, NULL);
-
-			if(sample->dt > 0) {
-				element->queue = g_list_prepend(element->queue, sample);
-				g_cond_broadcast(&element->queue_data_avail);
-			} else
-				g_free(sample);
-			if(locked != element->pll_locked) {
-				element->pll_locked = locked;
-				GST_INFO_OBJECT(element, locked ? "PLL locked" : "PLL unlocked");
-				g_object_notify(G_OBJECT(element), "pll-locked");
-			}
-		}
-		g_mutex_unlock(&element->queue_lock);
-		g_match_info_free(match_info);
-		g_string_erase(buffer, 0, n);
-	}
 
-done:
-	pll_free(pll);
-	g_string_free(buffer, TRUE);
-	g_regex_unref(ver_pattern);
-	g_regex_unref(ser_pattern);
-	g_regex_unref(raw_pattern);
-	gst_object_unref(clock);
-	g_cond_broadcast(&element->queue_data_avail);
-	return NULL;
+static gboolean read_raw_record(FILE *file, unsigned char *packet, GstClockTime *t)
+{
+	guint64 t64;
+
+	if(fread(&t64, sizeof(t64), 1, file) != 1 || fread(packet, 1, WILDDEVINE_PACKET_SIZE, file) != WILDDEVINE_PACKET_SIZE)
+		return FALSE;
+	*t = t64;
+
+	return TRUE;
 }
 
 
 /*
- * (t1 - t0) / dt
+ * packet synthesizer.  samples are generated at the device's nominal
+ * rate from a model photoplethysmograph, a systolic and a smaller
+ * diastolic peak in each heart beat amplitude-modulated by breathing,
+ * and a slowly wandering skin conductance.  each sample is formatted as
+ * the device would format it, split across packets, and given a time of
+ * arrival rounded up to the next millisecond plus 0--2 ms of jitter to
+ * mimic the device's timing residuals.  the jitter comes from a fixed
+ * seed so the packet stream is the same every time.
  */
 
 
-static double sample_diff(GstClockTime t1, GstClockTime t0, GstClockTimeDiff dt)
+struct synth {
+	GRand *rand;
+	guint64 n;		/* index of next sample */
+	char text[32];
+	gint length;		/* bytes in text */
+	gint pos;		/* bytes of text already sent */
+	GstClockTime t;		/* time of arrival of text */
+};
+
+
+static void synth_init(struct synth *synth)
 {
-	return ((double) GST_CLOCK_DIFF(t0, t1)) / dt;
+	synth->rand = g_rand_new_with_seed(SYNTH_SEED);
+	synth->n = 0;
+	synth->length = synth->pos = 0;
 }
 
 
-/*
- * how many samples separate the head of the queue from t
- */
+static double model_ppg(double t)
+{
+	double systolic = (fmod(t * SYNTH_HEART_RATE, 1.) - .15) / .05;
+	double diastolic = (fmod(t * SYNTH_HEART_RATE, 1.) - .40) / .08;
+
+	return (1. + .1 * sin(2. * M_PI * SYNTH_BREATHING_RATE * t)) * (exp(-.5 * systolic * systolic) + .4 * exp(-.5 * diastolic * diastolic));
+}
 
 
-static int queued_look_ahead(const GList *list, GstClockTime t)
+static void synth_packet(struct synth *synth, unsigned char *packet, GstClockTime *t)
 {
-	struct queued_sample *sample;
-	if(!list)
-		return -1;
-	sample = (struct queued_sample *) list->data;
-	return round(sample_diff(sample->t, t, sample->dt));
+	gint n;
+
+	if(synth->pos == synth->length) {
+		double t_sample = synth->n++ / DEVICE_RATE;
+		guint scl = 0x1000 + 0x100 * sin(2. * M_PI * t_sample / 60.);
+		guint ppg = 0x4000 + 0x2000 * model_ppg(t_sample);
+
+		synth->length = g_snprintf(synth->text, sizeof(synth->text), "<RAW>%04X %04X<\\RAW>", scl, ppg);
+		synth->pos = 0;
+		synth->t = ((GstClockTime) ceil(t_sample * 1000.) + g_rand_int_range(synth->rand, 0, 3)) * GST_MSECOND;
+	}
+
+	/* first byte gives number of remaining bytes that contain data */
+	n = MIN(synth->length - synth->pos, WILDDEVINE_PACKET_SIZE - 1);
+	memset(packet, 0, WILDDEVINE_PACKET_SIZE);
+	packet[0] = n;
+	memcpy(packet + 1, synth->text + synth->pos, n);
+	synth->pos += n;
+	*t = synth->t;
 }
 
 
 /*
- * sinc kernel
+ * add a sample to the ring.  called only from the collector.  never
+ * blocks:  if the ring is full the sample is dropped and FALSE returned.
+ * the lock is taken only if fill() is asleep waiting for data
  */
 
 
-static double sinc(double x)
+static gboolean ring_push(GstWildDevine *element, const struct queued_sample *sample)
 {
-	x *= M_PI;
-	return x != 0. ? sin(x) / x : 1.0;
+	guint head = element->ring_head;
+
+	if(head - (guint) g_atomic_int_get(&element->ring_tail) > element->ring_mask)
+		return FALSE;
+
+	element->ring[head & element->ring_mask] = *sample;
+	/* publish.  the atomic store orders the sample before the new
+	 * head and the load of ring_waiting after it */
+	g_atomic_int_set(&element->ring_head, head + 1);
+
+	if(g_atomic_int_get(&element->ring_waiting)) {
+		g_mutex_lock(&element->queue_lock);
+		g_cond_signal(&element->queue_data_avail);
+		g_mutex_unlock(&element->queue_lock);
+	}
+
+	return TRUE;
 }
 
 
 /*
- * ============================================================================
+ * sample collection.  several interrupt transfers are kept in flight so
+ * that the device always has somewhere to put its next packet.  each
+ * transfer is timestamped, recorded, parsed, and resubmitted from its
+ * completion callback, which runs in the shared libusb event thread.  a
+ * timeout only means the device had nothing to send and the transfer is
+ * resubmitted.  when replaying or synthesizing, a collection thread
+ * reads or makes the packets itself and no transfers are used.
  *
- *                             GstBaseSrc Methods
+ * if the device goes away the transfers are cancelled and the collector
+ * is marked lost.  fill() then outputs gaps and, once the transfers have
+ * been retired, looks for the device again.
  *
- * ============================================================================
+ * the lock serializes stopping and losing the device against
+ * resubmission, so that no transfer is submitted after the transfers
+ * have been cancelled, and guards the count of transfers in flight,
+ * which is signalled when it reaches 0.
  */
 
 
-static gboolean start(GstBaseSrc *src)
-{
-	GstWildDevine *element = GST_WILDDEVINE(src);
-	gboolean success = TRUE;
-
-	if(!open_device(element)) {
-		success = FALSE;
-		goto done;
-	}
-
-	libusb_detach_kernel_driver(element->usb_handle, WILDDEVINE_INTERFACE);
-	if(libusb_claim_interface(element->usb_handle, WILDDEVINE_INTERFACE)) {
-		GST_ERROR_OBJECT(element, "libusb_claim_interface() failed");
-		libusb_close(element->usb_handle);
-		element->usb_handle = NULL;
-		success = FALSE;
-		goto done;
-	}
-
-	element->next_offset = 0;
-
-	g_assert(element->queue == NULL);
+struct collector {
+	GstWildDevine *element;
+	GstClock *clock;	/* pipeline clock, once known */
+	struct parser parser;
+	struct pll *pll;
+	guint64 samples;	/* since the PLL was last reset */
+	GstClockTime base_time;	/* that the samples are timed against */
+	struct synth synth;
+	GMutex lock;
+	GCond retired;
+	struct libusb_transfer *transfers[NUM_TRANSFERS];
+	unsigned char buffers[NUM_TRANSFERS][WILDDEVINE_PACKET_SIZE];
+	gint in_flight;
+	gboolean stopping;
+	volatile gint lost;
+};
 
-	element->stop_requested = FALSE;
-	element->pll_locked = FALSE;
-	element->collect_thread = g_thread_new(NULL, collect_thread, element);
 
-done:
-	return success;
+static struct collector *collector_new(GstWildDevine *element)
+{
+	struct collector *collector = g_new(struct collector, 1);
+	gint i;
+
+	collector->element = element;
+	collector->clock = NULL;
+	parser_init(&collector->parser);
+	collector->pll = pll_new(PLL_DEFAULT_PHASE_GAIN, PLL_DEFAULT_FREQUENCY_GAIN);
+	pll_set_acquisition_boost(collector->pll, PLL_ACQUISITION_BOOST);
+	collector->samples = 0;
+	collector->base_time = GST_CLOCK_TIME_NONE;
+	synth_init(&collector->synth);
+	g_mutex_init(&collector->lock);
+	g_cond_init(&collector->retired);
+	for(i = 0; i < NUM_TRANSFERS; i++)
+		collector->transfers[i] = NULL;
+	collector->in_flight = 0;
+	collector->stopping = FALSE;
+	collector->lost = FALSE;
+
+	return collector;
 }
 
 
-static gboolean stop(GstBaseSrc *src)
+static void collector_free(struct collector *collector)
 {
-	GstWildDevine *element = GST_WILDDEVINE(src);
-	gboolean success = TRUE;
+	gint i;
+
+	for(i = 0; i < NUM_TRANSFERS; i++)
+		libusb_free_transfer(collector->transfers[i]);
+	g_rand_free(collector->synth.rand);
+	pll_free(collector->pll);
+	if(collector->clock)
+		gst_object_unref(collector->clock);
+	g_mutex_clear(&collector->lock);
+	g_cond_clear(&collector->retired);
+	g_free(collector);
+}
 
-	element->stop_requested = TRUE;
-	g_thread_join(element->collect_thread);
-	element->collect_thread = NULL;
 
-	g_list_free_full(element->queue, g_free);
-	element->queue = NULL;
+/*
+ * current running time of the pipeline.  samples are timestamped in the
+ * pipeline's running time so that they can be compared directly with
+ * other streams, e.g., video, and the PLL tracks the device's sample
+ * clock against the pipeline clock.  the element is not given a clock
+ * until the pipeline goes to PLAYING, which is after the collector has
+ * been started, so the clock is looked up on first use.  the running
+ * time does not advance while the pipeline is paused, so returns
+ * GST_CLOCK_TIME_NONE unless the element is PLAYING, and samples that
+ * arrive meanwhile are discarded.  can be called from any thread
+ */
 
-	libusb_release_interface(element->usb_handle, WILDDEVINE_INTERFACE);
-	libusb_close(element->usb_handle);
-	element->usb_handle = NULL;
 
-	return success;
+static GstClockTime running_time(struct collector *collector)
+{
+	GstElement *element = GST_ELEMENT(collector->element);
+	GstClock *clock = g_atomic_pointer_get(&collector->clock);
+	GstClockTime now, base_time;
+
+	if(GST_STATE(element) != GST_STATE_PLAYING)
+		return GST_CLOCK_TIME_NONE;
+	if(!clock) {
+		clock = gst_element_get_clock(element);
+		if(!clock)
+			return GST_CLOCK_TIME_NONE;
+		if(!g_atomic_pointer_compare_and_exchange(&collector->clock, NULL, clock)) {
+			/* another thread got there first */
+			gst_object_unref(clock);
+			clock = g_atomic_pointer_get(&collector->clock);
+		}
+	}
+
+	now = gst_clock_get_time(clock);
+	base_time = gst_element_get_base_time(element);
+	return now >= base_time ? now - base_time : GST_CLOCK_TIME_NONE;
 }
 
 
-static gboolean unlock(GstBaseSrc *src)
-{
-	GST_WILDDEVINE(src)->stop_requested = TRUE;
-	return TRUE;
-}
+/*
+ * on resuming from pause the pipeline is given a new base time, and the
+ * running time steps back to where it was when the pipeline was paused.
+ * the PLL can't follow the step, and samples timed against the old base
+ * time can't be interpolated together with those timed against the new,
+ * so the PLL is reset and fill() is told to discard the samples queued
+ * so far.  called from the USB collector.  recordings and the
+ * synthesizer carry their own times, which are unaffected
+ */
 
 
-static GstFlowReturn fill(GstBaseSrc *src, guint64 offset, guint size, GstBuffer *buf)
+static void check_base_time(struct collector *collector)
 {
-	GstWildDevine *element = GST_WILDDEVINE(src);
-	GList *queue = NULL;
-	GstMapInfo dstmap;
-	gfloat *data;
-	gint length, i;
-	GstFlowReturn result = GST_FLOW_OK;
+	GstWildDevine *element = collector->element;
+	GstClockTime base_time = gst_element_get_base_time(GST_ELEMENT(element));
+
+	if(base_time == collector->base_time)
+		return;
+	if(GST_CLOCK_TIME_IS_VALID(collector->base_time)) {
+		GST_INFO_OBJECT(element, "base time changed, resetting PLL");
+		pll_reset(collector->pll);
+		collector->samples = 0;
+		g_atomic_int_set(&element->ring_rebase, element->ring_head);
+		g_atomic_int_set(&element->ring_rebased, TRUE);
+	}
+	collector->base_time = base_time;
+}
 
-	g_assert_cmpuint(size % UNIT_SIZE, ==, 0);
 
-	/*
-	 * set metadata
-	 */
+/*
+ * wake fill() so that it sees the collection has ended or the device has
+ * come or gone
+ */
 
-	GST_BUFFER_OFFSET(buf) = element->next_offset;
-	element->next_offset += length = size / UNIT_SIZE;
-	GST_BUFFER_OFFSET_END(buf) = element->next_offset;
-	GST_BUFFER_PTS(buf) = GST_BUFFER_DTS(buf) = gst_util_uint64_scale_int_round(GST_BUFFER_OFFSET(buf), GST_SECOND, RATE);
-	GST_BUFFER_DURATION(buf) = gst_util_uint64_scale_int_round(GST_BUFFER_OFFSET_END(buf), GST_SECOND, RATE) - GST_BUFFER_PTS(buf);
 
-	/*
-	 * wait for data.  after this, we can use queue without holding
-	 * lock.  list manipulation performed by collect_thread() will not
-	 * modify this part of the list, nor will what we do interfer with
-	 * what it's doing
-	 */
+static void collector_wake(struct collector *collector)
+{
+	GstWildDevine *element = collector->element;
 
 	g_mutex_lock(&element->queue_lock);
-	while(element->collect_status == GST_FLOW_OK && queued_look_ahead(element->queue, GST_BUFFER_PTS(buf) + GST_BUFFER_DURATION(buf)) < KERNEL_LENGTH / 2)
-		g_cond_wait(&element->queue_data_avail, &element->queue_lock);
-	result = element->collect_status;
-	queue = element->queue;
+	g_cond_broadcast(&element->queue_data_avail);
 	g_mutex_unlock(&element->queue_lock);
+}
 
-	if(result != GST_FLOW_OK)
-		goto done;
 
-	/*
-	 * fill buffer
-	 */
+/*
+ * cancel all transfers and record the reason.  the first reason wins
+ */
 
-	gst_buffer_map(buf, &dstmap, GST_MAP_WRITE);
-	data = (gfloat *) dstmap.data;
-	memset(data, 0, size);
-	for(data = (gfloat *) dstmap.data, i = 0; i < length; data += 2, i++) {
-		GstClockTime t = GST_BUFFER_PTS(buf) + gst_util_uint64_scale_int_round(i, GST_SECOND, RATE);
-		GList *queue_elem;
 
-		/*
-		 * loop over queued data
-		 */
+static void collector_stop(struct collector *collector, GstFlowReturn status)
+{
+	gint i;
+
+	g_mutex_lock(&collector->lock);
+	if(!collector->stopping) {
+		collector->element->collect_status = status;
+		collector->stopping = TRUE;
+		for(i = 0; i < NUM_TRANSFERS; i++)
+			if(collector->transfers[i])
+				libusb_cancel_transfer(collector->transfers[i]);
+	}
+	g_mutex_unlock(&collector->lock);
+	collector_wake(collector);
+}
 
-		for(queue_elem = queue; queue_elem; queue_elem = g_list_next(queue_elem)) {
-			struct queued_sample *sample = queue_elem->data;
-			double dn = sample_diff(sample->t, t, sample->dt);
-			double kernel;
-
-			if(dn > KERNEL_LENGTH / 2)
-				/* sample is too new */
-				continue;
-
-			if(dn < -KERNEL_LENGTH / 2) {
-				/*
-				 * from this sample to the end of the queue
-				 * are no longer needed, remove them.  it
-				 * should be impossible that this sequence
-				 * includes the first element in the list
-				 */
-
-				g_assert(g_list_previous(queue_elem) != NULL);
-				g_list_previous(queue_elem)->next = NULL;
-				g_list_free_full(queue_elem, g_free);
-				queue_elem = NULL;
-				break;
-			}
 
-			/*
-			 * channel 0:  skin conductance
-			 * channel 1:  photoplethysmograph
-			 */
+/*
+ * the device has gone away.  cancel the remaining transfers but keep the
+ * stream going
+ */
+
 
-			kernel = sinc(dn);
-			data[0] += kernel * sample->scl;
-			data[1] += kernel * sample->ppg;
-		}
+static void collector_lose(struct collector *collector)
+{
+	gint i;
+
+	g_mutex_lock(&collector->lock);
+	if(!collector->stopping && !collector->lost) {
+		GST_WARNING_OBJECT(collector->element, "device lost");
+		g_atomic_int_set(&collector->lost, TRUE);
+		for(i = 0; i < NUM_TRANSFERS; i++)
+			if(collector->transfers[i])
+				libusb_cancel_transfer(collector->transfers[i]);
 	}
-	gst_buffer_unmap(buf, &dstmap);
-
-done:
-	return result;
+	g_mutex_unlock(&collector->lock);
 }
 
 
 /*
- * ============================================================================
- *
- *                              GObject Methods
- *
- * ============================================================================
+ * copy the clock recovery's state to where the properties can see it,
+ * and post it to the bus every telemetry_interval of running time.  the
+ * device's sample clock is measured against the pipeline clock:  the
+ * offset is the running time at which the sample count was 0,
+ * extrapolated at the nominal rate, and the drift is the fractional rate
+ * error
  */
 
 
-enum property {
-	ARG_VERSION = 1,
-	ARG_SERIAL,
-	ARG_PLL_LOCKED
-};
-
-
-static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+static void update_telemetry(struct collector *collector, const struct queued_sample *sample)
 {
-	GstWildDevine *element = GST_WILDDEVINE(object);
+	GstWildDevine *element = collector->element;
+	GstStructure *s = NULL;
 
 	GST_OBJECT_LOCK(element);
+	element->clock_offset = GST_CLOCK_DIFF((GstClockTime) llround(collector->samples * GST_SECOND / DEVICE_RATE), sample->t);
+	element->clock_drift = sample->dt > 0 ? ((double) GST_SECOND / sample->dt / DEVICE_RATE - 1.) * 1e6 : 0.;
+	element->sample_period = sample->dt;
+	element->phase_error_rms = pll_phase_error_rms(collector->pll);
+	element->lock_time = pll_lock_time(collector->pll);
+	if(element->telemetry_interval && (!GST_CLOCK_TIME_IS_VALID(element->last_telemetry) || sample->t - element->last_telemetry >= element->telemetry_interval)) {
+		element->last_telemetry = sample->t;
+		s = gst_structure_new("telemetry",
+			"timestamp", G_TYPE_UINT64, sample->t,
+			"locked", G_TYPE_BOOLEAN, collector->pll->locked,
+			"phase-error-rms", G_TYPE_DOUBLE, element->phase_error_rms,
+			"sample-period", G_TYPE_INT64, element->sample_period,
+			"lock-time", G_TYPE_UINT64, element->lock_time,
+			"gain-boost", G_TYPE_DOUBLE, pll_boost(collector->pll),
+			"pll-faults", G_TYPE_UINT64, pll_faults(collector->pll),
+			"clock-offset", G_TYPE_INT64, element->clock_offset,
+			"clock-drift", G_TYPE_DOUBLE, element->clock_drift,
+			"samples-rejected", G_TYPE_UINT64, element->samples_rejected,
+			"samples-dropped", G_TYPE_UINT64, element->samples_dropped,
+			NULL
+		);
+	}
+	GST_OBJECT_UNLOCK(element);
 
-	switch(prop_id) {
-	case ARG_VERSION:
-		g_value_set_uint64(value, element->version);
-		break;
+	if(s)
+		gst_element_post_message(GST_ELEMENT(element), gst_message_new_element(GST_OBJECT(element), s));
+}
 
-	case ARG_SERIAL:
-		g_value_set_uint64(value, element->serial);
-		break;
 
-	case ARG_PLL_LOCKED:
+static void parse_packet(struct collector *collector, const unsigned char *packet, gint length, GstClockTime t)
+{
+	GstWildDevine *element = collector->element;
+	gint i;
+
+	/* first byte recieved gives number of remaining bytes that
+	 * contain data */
+	for(i = 1; i <= packet[0] && i < length; i++) {
+		struct queued_sample sample;
+		gboolean locked;
+
+		switch(parser_push(&collector->parser, packet[i])) {
+		case TAG_NONE:
+			break;
+
+		case TAG_VER:
+			if(collector->parser.value[0] != element->version) {
+				element->version = collector->parser.value[0];
+				GST_INFO_OBJECT(element, "version = %" G_GUINT64_FORMAT, element->version);
+				g_object_notify(G_OBJECT(element), "version");
+			}
+			break;
+
+		case TAG_SER:
+			if(collector->parser.value[0] != element->serial) {
+				element->serial = collector->parser.value[0];
+				GST_INFO_OBJECT(element, "serial = %" G_GUINT64_FORMAT, element->serial);
+				g_object_notify(G_OBJECT(element), "serial");
+			}
+			break;
+
+		case TAG_RAW:
+			if(!GST_CLOCK_TIME_IS_VALID(t))
+				/* pipeline not running */
+				break;
+			sample.t = pll_correct(collector->pll, t, &locked);
+			sample.dt = pll_period(collector->pll);
+			sample.scl = collector->parser.value[0] / 65536.0;
+			sample.ppg = collector->parser.value[1] / 65536.0;
+
+			if(sample.dt <= 0) {
+				/* period not yet known, e.g., first sample
+				 * after a reset */
+				GST_DEBUG_OBJECT(element, "rejecting sample at %" GST_TIME_FORMAT ", period unknown", GST_TIME_ARGS(sample.t));
+				element->samples_rejected++;
+			} else if(!ring_push(element, &sample)) {
+				GST_WARNING_OBJECT(element, "sample ring full, dropping sample at %" GST_TIME_FORMAT, GST_TIME_ARGS(sample.t));
+				element->samples_dropped++;
+			}
+
+			update_telemetry(collector, &sample);
+			collector->samples++;
+
+			if(locked != element->pll_locked) {
+				element->pll_locked = locked;
+				GST_INFO_OBJECT(element, locked ? "PLL locked" : "PLL unlocked");
+				g_object_notify(G_OBJECT(element), "pll-locked");
+			}
+			break;
+		}
+	}
+}
+
+
+/*
+ * append the packet to the recording, if one is being made
+ */
+
+
+static gboolean record_packet(struct collector *collector, const unsigned char *packet, GstClockTime t)
+{
+	GstWildDevine *element = collector->element;
+
+	if(element->record_file && !write_raw_record(element->record_file, packet, t)) {
+		GST_ELEMENT_ERROR(element, RESOURCE, WRITE, (NULL), ("%s: %s", element->record_location, g_strerror(errno)));
+		collector_stop(collector, GST_FLOW_ERROR);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static void LIBUSB_CALL transfer_callback(struct libusb_transfer *transfer)
+{
+	struct collector *collector = transfer->user_data;
+	GstWildDevine *element = collector->element;
+	/* time of arrival.  taken first thing to minimize jitter */
+	GstClockTime t = running_time(collector);
+	gint err;
+
+	switch(transfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		if(transfer->actual_length != transfer->length) {
+			/* ... but bad read size */
+			GST_ERROR_OBJECT(element, "read %d bytes, expected %d", transfer->actual_length, transfer->length);
+			collector_stop(collector, GST_FLOW_ERROR);
+			goto retire;
+		}
+		if(GST_CLOCK_TIME_IS_VALID(t)) {
+			check_base_time(collector);
+			if(!record_packet(collector, transfer->buffer, t))
+				goto retire;
+		}
+		parse_packet(collector, transfer->buffer, transfer->actual_length, t);
+		break;
+
+	case LIBUSB_TRANSFER_TIMED_OUT:
+		/* device had nothing to send.  try again */
+		GST_DEBUG_OBJECT(element, "timeout");
+		break;
+
+	case LIBUSB_TRANSFER_CANCELLED:
+		goto retire;
+
+	case LIBUSB_TRANSFER_STALL:
+		/* transfer was halted.  treat as a glitch in the
+		 * connection */
+		GST_WARNING_OBJECT(element, "transfer halted");
+		collector_lose(collector);
+		goto retire;
+
+	case LIBUSB_TRANSFER_OVERFLOW:
+		/* too much data arrived */
+		GST_ERROR_OBJECT(element, "transfer overflow");
+		collector_stop(collector, GST_FLOW_ERROR);
+		goto retire;
+
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		/* device has been unplugged */
+		GST_WARNING_OBJECT(element, "unplugged");
+		collector_lose(collector);
+		goto retire;
+
+	default:
+		/* other error.  usually seen while the device is being
+		 * unplugged */
+		GST_WARNING_OBJECT(element, "transfer error");
+		collector_lose(collector);
+		goto retire;
+	}
+
+	g_mutex_lock(&collector->lock);
+	err = collector->stopping || collector->lost ? LIBUSB_ERROR_INTERRUPTED : libusb_submit_transfer(transfer);
+	g_mutex_unlock(&collector->lock);
+	switch(err) {
+	case LIBUSB_SUCCESS:
+		return;
+
+	case LIBUSB_ERROR_INTERRUPTED:
+		break;
+
+	case LIBUSB_ERROR_NO_DEVICE:
+		GST_WARNING_OBJECT(element, "unplugged");
+		collector_lose(collector);
+		break;
+
+	default:
+		GST_ERROR_OBJECT(element, "libusb_submit_transfer() failed");
+		collector_stop(collector, GST_FLOW_ERROR);
+		break;
+	}
+
+retire:
+	g_mutex_lock(&collector->lock);
+	if(!--collector->in_flight) {
+		g_cond_broadcast(&collector->retired);
+		collector_wake(collector);
+	}
+	g_mutex_unlock(&collector->lock);
+}
+
+
+/*
+ * submit the transfers.  from here on the shared event thread does the
+ * work.  also used to resume after the device has been found again
+ */
+
+
+static void collect_usb_start(struct collector *collector)
+{
+	GstWildDevine *element = collector->element;
+	gboolean failed = FALSE;
+	gint i;
+
+	g_mutex_lock(&collector->lock);
+	g_atomic_int_set(&collector->lost, FALSE);
+	for(i = 0; i < NUM_TRANSFERS; i++) {
+		if(!collector->transfers[i])
+			collector->transfers[i] = libusb_alloc_transfer(0);
+		libusb_fill_interrupt_transfer(collector->transfers[i], element->usb_handle, WILDDEVINE_ENDPOINT, collector->buffers[i], WILDDEVINE_PACKET_SIZE, transfer_callback, collector, WILDDEVINE_TIMEOUT);
+	}
+	for(i = 0; i < NUM_TRANSFERS; i++) {
+		if(libusb_submit_transfer(collector->transfers[i])) {
+			GST_ERROR_OBJECT(element, "libusb_submit_transfer() failed");
+			failed = TRUE;
+			break;
+		}
+		collector->in_flight++;
+	}
+	g_mutex_unlock(&collector->lock);
+
+	if(failed)
+		collector_stop(collector, GST_FLOW_ERROR);
+}
+
+
+/*
+ * cancel the transfers and wait for the event thread to retire them
+ */
+
+
+static void collect_usb_stop(struct collector *collector)
+{
+	collector_stop(collector, GST_FLOW_EOS);
+
+	g_mutex_lock(&collector->lock);
+	while(collector->in_flight)
+		g_cond_wait(&collector->retired, &collector->lock);
+	g_mutex_unlock(&collector->lock);
+}
+
+
+/*
+ * packets from a recording or the synthesizer in place of the device.
+ * at the recorded pace the thread sleeps until each packet's time of
+ * arrival, measured from the first packet's.  fast or not, it waits for
+ * room in the ring before each packet so that no sample is dropped
+ * however far ahead of the pipeline it gets.  packets are at most 8
+ * bytes, so each completes at most one sample.  a stop request is
+ * noticed within WILDDEVINE_TIMEOUT
+ */
+
+
+static void collect_replay(struct collector *collector)
+{
+	GstWildDevine *element = collector->element;
+	GstClockTime t0 = GST_CLOCK_TIME_NONE;
+
+	while(!collector->stopping) {
+		unsigned char packet[WILDDEVINE_PACKET_SIZE];
+		GstClockTime t, now;
+
+		if(element->synthesize)
+			synth_packet(&collector->synth, packet, &t);
+		else if(!read_raw_record(element->replay_file, packet, &t)) {
+			if(ferror(element->replay_file)) {
+				GST_ELEMENT_ERROR(element, RESOURCE, READ, (NULL), ("%s: %s", element->replay_location, g_strerror(errno)));
+				collector_stop(collector, GST_FLOW_ERROR);
+			} else {
+				GST_INFO_OBJECT(element, "end of recording");
+				collector_stop(collector, GST_FLOW_EOS);
+			}
+			break;
+		}
+
+		if(!element->replay_fast) {
+			if(!GST_CLOCK_TIME_IS_VALID(t0) || t < t0)
+				t0 = t;
+			while(!element->stop_requested && (!GST_CLOCK_TIME_IS_VALID(now = running_time(collector)) || now < t - t0))
+				g_usleep((GST_CLOCK_TIME_IS_VALID(now) ? MIN(t - t0 - now, WILDDEVINE_TIMEOUT * GST_MSECOND) : WILDDEVINE_TIMEOUT * GST_MSECOND) / GST_USECOND);
+		}
+		while(!element->stop_requested && element->ring_head - (guint) g_atomic_int_get(&element->ring_tail) > element->ring_mask)
+			g_usleep(1000);
+
+		if(element->stop_requested) {
+			collector_stop(collector, GST_FLOW_EOS);
+			break;
+		}
+
+		if(record_packet(collector, packet, t))
+			parse_packet(collector, packet, WILDDEVINE_PACKET_SIZE, t);
+	}
+}
+
+
+static gpointer collect_thread(gpointer _collector)
+{
+	struct collector *collector = _collector;
+
+	collect_replay(collector);
+	collector_wake(collector);
+
+	return NULL;
+}
+
+
+/*
+ * recovery from a lost device.  a hot-plug callback, where libusb
+ * supports them, says when a device has arrived;  otherwise, and as a
+ * fallback, the device is looked for every RECONNECT_INTERVAL.  the
+ * looking is done by fill(), which carries on producing gaps meanwhile.
+ */
+
+
+static int LIBUSB_CALL hotplug_callback(libusb_context *context, libusb_device *device, libusb_hotplug_event event, void *data)
+{
+	GstWildDevine *element = GST_WILDDEVINE(data);
+
+	g_atomic_int_set(&element->device_arrived, TRUE);
+	g_mutex_lock(&element->queue_lock);
+	g_cond_broadcast(&element->queue_data_avail);
+	g_mutex_unlock(&element->queue_lock);
+
+	/* stay registered */
+	return 0;
+}
+
+
+/*
+ * returns TRUE if the device is back.  once every transfer has been
+ * retired the old handle is closed and the device looked for.  on
+ * success the parser and PLL start over, with the PLL keeping its period
+ * estimate so it relocks quickly, samples from before the loss are
+ * discarded, and the transfers are resubmitted.  sample offsets carry on
+ * from where the gaps leave off
+ */
+
+
+static gboolean reconnect(GstWildDevine *element)
+{
+	struct collector *collector = element->collector;
+	GstClockTime now = running_time(collector);
+	gboolean retired;
+
+	g_mutex_lock(&collector->lock);
+	retired = !collector->in_flight;
+	g_mutex_unlock(&collector->lock);
+	if(!retired)
+		return FALSE;
+
+	if(element->usb_handle) {
+		libusb_release_interface(element->usb_handle, WILDDEVINE_INTERFACE);
+		libusb_close(element->usb_handle);
+		element->usb_handle = NULL;
+		if(element->pll_locked) {
+			element->pll_locked = FALSE;
+			g_object_notify(G_OBJECT(element), "pll-locked");
+		}
+	}
+
+	if(!g_atomic_int_get(&element->device_arrived) && GST_CLOCK_TIME_IS_VALID(element->last_reconnect) && GST_CLOCK_TIME_IS_VALID(now) && now - element->last_reconnect < RECONNECT_INTERVAL)
+		return FALSE;
+	g_atomic_int_set(&element->device_arrived, FALSE);
+	element->last_reconnect = now;
+	if(!open_device(element))
+		return FALSE;
+
+	GST_INFO_OBJECT(element, "device found again");
+	parser_init(&collector->parser);
+	pll_reset(collector->pll);
+	collector->samples = 0;
+	g_atomic_int_set(&element->ring_tail, g_atomic_int_get(&element->ring_head));
+	collect_usb_start(collector);
+
+	return TRUE;
+}
+
+
+/*
+ * wait for the device to come back or for the running time to pass t_end,
+ * whichever is first, or until unlocked.  returns TRUE if the device is
+ * back
+ */
+
+
+static gboolean wait_for_device(GstWildDevine *element, GstClockTime t_end)
+{
+	struct collector *collector = element->collector;
+
+	while(element->collect_status == GST_FLOW_OK && !g_atomic_int_get(&element->flushing)) {
+		GstClockTime now;
+
+		if(reconnect(element))
+			return TRUE;
+		now = running_time(collector);
+		if(GST_CLOCK_TIME_IS_VALID(now) && now >= t_end)
+			break;
+
+		g_mutex_lock(&element->queue_lock);
+		if(element->collect_status == GST_FLOW_OK && !g_atomic_int_get(&element->device_arrived) && !g_atomic_int_get(&element->flushing))
+			g_cond_wait_until(&element->queue_data_avail, &element->queue_lock, g_get_monotonic_time() + (GST_CLOCK_TIME_IS_VALID(now) ? MIN(t_end - now, RECONNECT_INTERVAL) : RECONNECT_INTERVAL) / GST_USECOND);
+		g_mutex_unlock(&element->queue_lock);
+	}
+
+	return FALSE;
+}
+
+
+/*
+ * (t1 - t0) / dt
+ */
+
+
+static double sample_diff(GstClockTime t1, GstClockTime t0, GstClockTimeDiff dt)
+{
+	return ((double) GST_CLOCK_DIFF(t0, t1)) / dt;
+}
+
+
+/*
+ * how many samples separate the newest sample in the ring from t.  head
+ * is the producer's head index as last read by the caller
+ */
+
+
+static int queued_look_ahead(const GstWildDevine *element, guint head, GstClockTime t)
+{
+	const struct queued_sample *sample;
+	if(head == element->ring_tail)
+		return -1;
+	sample = &element->ring[(head - 1) & element->ring_mask];
+	return round(sample_diff(sample->t, t, sample->dt));
+}
+
+
+/*
+ * drop the samples the collector has marked stale, see
+ * check_base_time().  called only from fill()
+ */
+
+
+static void ring_discard_stale(GstWildDevine *element)
+{
+	guint rebase;
+
+	if(!g_atomic_int_compare_and_exchange(&element->ring_rebased, TRUE, FALSE))
+		return;
+	rebase = g_atomic_int_get(&element->ring_rebase);
+	if((gint) (rebase - element->ring_tail) > 0) {
+		GST_DEBUG_OBJECT(element, "discarding %u sample(s) timed against the old base time", rebase - element->ring_tail);
+		g_atomic_int_set(&element->ring_tail, rebase);
+	}
+}
+
+
+/*
+ * sinc kernel
+ */
+
+
+static double sinc(double x)
+{
+	x *= M_PI;
+	return x != 0. ? sin(x) / x : 1.0;
+}
+
+
+/*
+ * 4-term Blackman-Harris window spanning [-length/2, +length/2]
+ */
+
+
+static double blackman_harris(double x, double length)
+{
+	x *= 2. * M_PI / length;
+	return 0.35875 + 0.48829 * cos(x) + 0.14128 * cos(2. * x) + 0.01168 * cos(3. * x);
+}
+
+
+/*
+ * number of samples after an output sample that the kernel reaches.
+ * half the kernel normally, 1 in low-latency mode
+ */
+
+
+static gint kernel_look_ahead(GstWildDevine *element)
+{
+	return element->low_latency ? 1 : element->kernel_length / 2;
+}
+
+
+/*
+ * the most output samples a buffer can hold.  the device samples a
+ * buffer spans, plus the kernel's reach past either end, must all be in
+ * the ring at once or fill() would wait for samples the collector has no
+ * room to queue.  DEVICE_RATE is approximate, so keep some headroom
+ */
+
+
+static gint max_buffer_length(GstWildDevine *element)
+{
+	return MAX((gint) floor((element->ring_mask + 1 - element->kernel_length) * RING_HEADROOM * element->rate / DEVICE_RATE), 1);
+}
+
+
+/*
+ * interpolation kernel table.  row p holds the kernel_length weights for
+ * an output sample a fraction p / KERNEL_PHASES of a sample period after
+ * input sample k0, tap j multiplying input sample k0 - (kernel_length -
+ * look_ahead) + 1 + j.  the window's two halves are stretched
+ * independently to cover the taps on either side of the output sample,
+ * so in low-latency mode the kernel is an asymmetric windowed sinc
+ * reaching 1 sample into the future and the rest into the past.  each
+ * row is normalized to unit DC gain.
+ */
+
+
+static gdouble *make_kernel_table(gint length, gint look_ahead)
+{
+	gdouble *table = g_new(gdouble, (KERNEL_PHASES + 1) * length);
+	const gint behind = length - look_ahead;
+	gint p, j;
+
+	for(p = 0; p <= KERNEL_PHASES; p++) {
+		gdouble *row = table + p * length;
+		gdouble sum = 0.;
+		for(j = 0; j < length; j++) {
+			double x = j - behind + 1 - (double) p / KERNEL_PHASES;
+			row[j] = sinc(x) * blackman_harris(x, 2. * (x < 0. ? behind : look_ahead));
+			sum += row[j];
+		}
+		for(j = 0; j < length; j++)
+			row[j] /= sum;
+	}
+
+	return table;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                             GstBaseSrc Methods
+ *
+ * ============================================================================
+ */
+
+
+static void close_files(GstWildDevine *element)
+{
+	if(element->record_file) {
+		fclose(element->record_file);
+		element->record_file = NULL;
+	}
+	if(element->replay_file) {
+		fclose(element->replay_file);
+		element->replay_file = NULL;
+	}
+}
+
+
+static void close_device(GstWildDevine *element)
+{
+	if(element->hotplug_registered) {
+		libusb_hotplug_deregister_callback(element->usb_context, element->hotplug_handle);
+		element->hotplug_registered = FALSE;
+	}
+	if(element->usb_handle) {
+		libusb_release_interface(element->usb_handle, WILDDEVINE_INTERFACE);
+		libusb_close(element->usb_handle);
+		element->usb_handle = NULL;
+	}
+	if(element->usb_context) {
+		usb_context_unref();
+		element->usb_context = NULL;
+	}
+}
+
+
+static gboolean start(GstBaseSrc *src)
+{
+	GstWildDevine *element = GST_WILDDEVINE(src);
+	gboolean success = TRUE;
+
+	if(element->record_location) {
+		element->record_file = fopen(element->record_location, "wb");
+		if(!element->record_file) {
+			GST_ELEMENT_ERROR(element, RESOURCE, OPEN_WRITE, (NULL), ("%s: %s", element->record_location, g_strerror(errno)));
+			success = FALSE;
+			goto done;
+		}
+		if(!write_raw_header(element->record_file)) {
+			GST_ELEMENT_ERROR(element, RESOURCE, WRITE, (NULL), ("%s: %s", element->record_location, g_strerror(errno)));
+			success = FALSE;
+			goto done;
+		}
+	}
+
+	if(element->synthesize) {
+		/* no source of packets to open */
+	} else if(element->replay_location) {
+		element->replay_file = fopen(element->replay_location, "rb");
+		if(!element->replay_file) {
+			GST_ELEMENT_ERROR(element, RESOURCE, OPEN_READ, (NULL), ("%s: %s", element->replay_location, g_strerror(errno)));
+			success = FALSE;
+			goto done;
+		}
+		if(!read_raw_header(element->replay_file)) {
+			GST_ELEMENT_ERROR(element, STREAM, WRONG_TYPE, (NULL), ("%s: not a WildDevine recording or unsupported version", element->replay_location));
+			success = FALSE;
+			goto done;
+		}
+	} else {
+		element->usb_context = usb_context_ref();
+		if(!element->usb_context) {
+			success = FALSE;
+			goto done;
+		}
+		if(!open_device(element)) {
+			GST_ERROR_OBJECT(element, "device not found");
+			success = FALSE;
+			goto done;
+		}
+		if(libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) && !libusb_hotplug_register_callback(element->usb_context, LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED, LIBUSB_HOTPLUG_NO_FLAGS, WILDDEVINE_VEND_ID, WILDDEVINE_PROD_ID, LIBUSB_HOTPLUG_MATCH_ANY, hotplug_callback, element, &element->hotplug_handle))
+			element->hotplug_registered = TRUE;
+		else
+			GST_INFO_OBJECT(element, "hot-plug events not available, will poll for device if lost");
+	}
+
+	element->next_offset = 0;
+	g_free(element->kernels);
+	element->kernels = make_kernel_table(element->kernel_length, kernel_look_ahead(element));
+
+	element->ring_head = element->ring_tail = 0;
+	element->ring_waiting = FALSE;
+	element->ring_rebased = FALSE;
+	element->collect_status = GST_FLOW_OK;
+	element->stop_requested = FALSE;
+	element->flushing = FALSE;
+	element->pll_locked = FALSE;
+	element->device_arrived = FALSE;
+	element->last_reconnect = GST_CLOCK_TIME_NONE;
+	element->clock_offset = 0;
+	element->clock_drift = 0.;
+	element->phase_error_rms = 0.;
+	element->sample_period = 0;
+	element->lock_time = GST_CLOCK_TIME_NONE;
+	element->samples_rejected = element->samples_dropped = 0;
+	element->last_telemetry = GST_CLOCK_TIME_NONE;
+	element->collector = collector_new(element);
+	if(element->usb_handle)
+		collect_usb_start(element->collector);
+	else
+		element->collect_thread = g_thread_new(NULL, collect_thread, element->collector);
+
+done:
+	if(!success) {
+		close_device(element);
+		close_files(element);
+	}
+	return success;
+}
+
+
+static gboolean stop(GstBaseSrc *src)
+{
+	GstWildDevine *element = GST_WILDDEVINE(src);
+	gboolean success = TRUE;
+
+	element->stop_requested = TRUE;
+	if(element->collect_thread) {
+		g_thread_join(element->collect_thread);
+		element->collect_thread = NULL;
+	} else
+		collect_usb_stop(element->collector);
+	collector_free(element->collector);
+	element->collector = NULL;
+
+	close_device(element);
+	close_files(element);
+
+	g_free(element->kernels);
+	element->kernels = NULL;
+
+	return success;
+}
+
+
+/*
+ * make fill() return GST_FLOW_FLUSHING, e.g., on pausing.  collection
+ * carries on:  stop() ends it
+ */
+
+
+static gboolean unlock(GstBaseSrc *src)
+{
+	GstWildDevine *element = GST_WILDDEVINE(src);
+
+	g_mutex_lock(&element->queue_lock);
+	g_atomic_int_set(&element->flushing, TRUE);
+	g_cond_broadcast(&element->queue_data_avail);
+	g_mutex_unlock(&element->queue_lock);
+
+	return TRUE;
+}
+
+
+static gboolean unlock_stop(GstBaseSrc *src)
+{
+	GstWildDevine *element = GST_WILDDEVINE(src);
+
+	g_atomic_int_set(&element->flushing, FALSE);
+
+	return TRUE;
+}
+
+
+static GstCaps *get_caps(GstBaseSrc *src, GstCaps *filter)
+{
+	GstWildDevine *element = GST_WILDDEVINE(src);
+	GstCaps *caps = gst_caps_make_writable(gst_pad_get_pad_template_caps(GST_BASE_SRC_PAD(src)));
+
+	GST_OBJECT_LOCK(element);
+	gst_caps_set_simple(caps, "rate", G_TYPE_INT, element->rate, NULL);
+	GST_OBJECT_UNLOCK(element);
+
+	if(filter) {
+		GstCaps *intersection = gst_caps_intersect_full(filter, caps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(caps);
+		caps = intersection;
+	}
+
+	return caps;
+}
+
+
+/*
+ * a buffer can be completed once a sample look_ahead samples past its
+ * end has arrived from the device
+ */
+
+
+static gboolean query(GstBaseSrc *src, GstQuery *query)
+{
+	GstWildDevine *element = GST_WILDDEVINE(src);
+	GstClockTime latency;
+	guint blocksize;
+
+	switch(GST_QUERY_TYPE(query)) {
+	case GST_QUERY_LATENCY:
+		blocksize = gst_base_src_get_blocksize(src);
+		GST_OBJECT_LOCK(element);
+		latency = gst_util_uint64_scale_int_round(blocksize / UNIT_SIZE, GST_SECOND, element->rate) + (GstClockTime) round(kernel_look_ahead(element) * GST_SECOND / DEVICE_RATE);
+		GST_OBJECT_UNLOCK(element);
+		GST_DEBUG_OBJECT(element, "latency %" GST_TIME_FORMAT, GST_TIME_ARGS(latency));
+		gst_query_set_latency(query, gst_base_src_is_live(src), latency, latency);
+		return TRUE;
+
+	default:
+		return GST_BASE_SRC_CLASS(gst_wilddevine_parent_class)->query(src, query);
+	}
+}
+
+
+static GstFlowReturn fill(GstBaseSrc *src, guint64 offset, guint size, GstBuffer *buf)
+{
+	GstWildDevine *element = GST_WILDDEVINE(src);
+	const guint mask = element->ring_mask;
+	const gint kernel_length = element->kernel_length;
+	const gint look_ahead = kernel_look_ahead(element);
+	const gint behind = kernel_length - look_ahead;
+	GstClockTime t_end;
+	GstMapInfo dstmap;
+	gfloat *data;
+	gint length, i;
+	guint head, tail, k0;
+	GstFlowReturn result = GST_FLOW_OK;
+
+	g_assert_cmpuint(size % UNIT_SIZE, ==, 0);
+
+	/*
+	 * a buffer longer than the ring can hold could never be completed.
+	 * shorten this one and the blocksize
+	 */
+
+	if(size / UNIT_SIZE > (guint) max_buffer_length(element)) {
+		guint max_size = max_buffer_length(element) * UNIT_SIZE;
+		GST_WARNING_OBJECT(element, "blocksize %u bytes exceeds the sample queue's capacity, reducing to %u bytes", size, max_size);
+		gst_base_src_set_blocksize(src, max_size);
+		gst_buffer_set_size(buf, max_size);
+		size = max_size;
+	}
+
+	/*
+	 * set metadata
+	 */
+
+	GST_BUFFER_OFFSET(buf) = element->next_offset;
+	element->next_offset += length = size / UNIT_SIZE;
+	GST_BUFFER_OFFSET_END(buf) = element->next_offset;
+	GST_BUFFER_PTS(buf) = GST_BUFFER_DTS(buf) = gst_util_uint64_scale_int_round(GST_BUFFER_OFFSET(buf), GST_SECOND, element->rate);
+	GST_BUFFER_DURATION(buf) = gst_util_uint64_scale_int_round(GST_BUFFER_OFFSET_END(buf), GST_SECOND, element->rate) - GST_BUFFER_PTS(buf);
+	t_end = GST_BUFFER_PTS(buf) + GST_BUFFER_DURATION(buf);
+
+	/*
+	 * wait for data.  the samples from tail up to head are ours to
+	 * read until tail is advanced.  sleep only if there aren't enough
+	 * yet, announcing it with ring_waiting before re-checking so that
+	 * a sample pushed in between is not missed.  if the device is lost
+	 * while waiting, wait for it to come back instead, and if it
+	 * hasn't by the time the buffer should have been complete send a
+	 * gap.  if unlocked, give up with GST_FLOW_FLUSHING
+	 */
+
+	ring_discard_stale(element);
+	head = g_atomic_int_get(&element->ring_head);
+	while(queued_look_ahead(element, head, t_end) < look_ahead) {
+		gboolean ready;
+
+		g_mutex_lock(&element->queue_lock);
+		g_atomic_int_set(&element->ring_waiting, TRUE);
+		while(TRUE) {
+			ring_discard_stale(element);
+			ready = queued_look_ahead(element, head = g_atomic_int_get(&element->ring_head), t_end) >= look_ahead;
+			if(ready || g_atomic_int_get(&element->collector->lost) || element->collect_status != GST_FLOW_OK || g_atomic_int_get(&element->flushing))
+				break;
+			g_cond_wait(&element->queue_data_avail, &element->queue_lock);
+		}
+		g_atomic_int_set(&element->ring_waiting, FALSE);
+		if(!ready)
+			result = g_atomic_int_get(&element->flushing) ? GST_FLOW_FLUSHING : element->collect_status;
+		g_mutex_unlock(&element->queue_lock);
+
+		if(ready || result != GST_FLOW_OK)
+			break;
+		if(!wait_for_device(element, t_end)) {
+			result = g_atomic_int_get(&element->flushing) ? GST_FLOW_FLUSHING : element->collect_status;
+			if(result == GST_FLOW_OK) {
+				GST_LOG_OBJECT(element, "device absent, sending gap");
+				gst_buffer_map(buf, &dstmap, GST_MAP_WRITE);
+				memset(dstmap.data, 0, dstmap.size);
+				gst_buffer_unmap(buf, &dstmap);
+				GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_GAP);
+			}
+			goto done;
+		}
+		head = g_atomic_int_get(&element->ring_head);
+	}
+
+	if(result != GST_FLOW_OK)
+		goto done;
+
+	/*
+	 * fill buffer
+	 */
+
+	tail = k0 = element->ring_tail;
+	gst_buffer_map(buf, &dstmap, GST_MAP_WRITE);
+	for(data = (gfloat *) dstmap.data, i = 0; i < length; data += 2, i++) {
+		GstClockTime t = GST_BUFFER_PTS(buf) + gst_util_uint64_scale_int_round(i, GST_SECOND, element->rate);
+		const struct queued_sample *sample;
+		const gdouble *kernel;
+		double scl = 0., ppg = 0.;
+		double frac;
+		gint j;
+
+		/*
+		 * find k0, the newest sample at or before t.  the samples
+		 * are in time order and t increases, so the search resumes
+		 * from the previous output sample's k0
+		 */
+
+		while(k0 + 1 != head && element->ring[(k0 + 1) & mask].t <= t)
+			k0++;
+		sample = &element->ring[k0 & mask];
+		frac = t > sample->t ? sample_diff(t, sample->t, sample->dt) : 0.;
+		kernel = element->kernels + (gint) round(MIN(frac, 1.) * KERNEL_PHASES) * kernel_length;
+
+		/*
+		 * channel 0:  skin conductance
+		 * channel 1:  photoplethysmograph
+		 *
+		 * samples beyond either end of the ring are replaced with
+		 * the first or last sample
+		 */
+
+		for(j = 0; j < kernel_length; j++) {
+			guint k = k0 - behind + 1 + j;
+			if((gint) (k - tail) < 0)
+				k = tail;
+			else if((gint) (k - head) >= 0)
+				k = head - 1;
+			sample = &element->ring[k & mask];
+			scl += kernel[j] * sample->scl;
+			ppg += kernel[j] * sample->ppg;
+		}
+		data[0] = scl;
+		data[1] = ppg;
+	}
+	gst_buffer_unmap(buf, &dstmap);
+
+	/*
+	 * release the samples no longer needed to the collection thread
+	 */
+
+	if((gint) (k0 - behind + 1 - tail) > 0)
+		tail = k0 - behind + 1;
+	g_atomic_int_set(&element->ring_tail, tail);
+
+done:
+	/* the buffer will be asked for again */
+	if(result == GST_FLOW_FLUSHING)
+		element->next_offset = GST_BUFFER_OFFSET(buf);
+	return result;
+}
+
+
+/*
+ * ============================================================================
+ *
+ *                              GObject Methods
+ *
+ * ============================================================================
+ */
+
+
+enum property {
+	ARG_VERSION = 1,
+	ARG_SERIAL,
+	ARG_PLL_LOCKED,
+	ARG_RATE,
+	ARG_KERNEL_LENGTH,
+	ARG_LOW_LATENCY,
+	ARG_RECORD_LOCATION,
+	ARG_REPLAY_LOCATION,
+	ARG_REPLAY_FAST,
+	ARG_SYNTHESIZE,
+	ARG_DEVICE_PATH,
+	ARG_DEVICE_SERIAL,
+	ARG_CLOCK_OFFSET,
+	ARG_CLOCK_DRIFT,
+	ARG_PHASE_ERROR_RMS,
+	ARG_SAMPLE_PERIOD,
+	ARG_LOCK_TIME,
+	ARG_SAMPLES_REJECTED,
+	ARG_SAMPLES_DROPPED,
+	ARG_TELEMETRY_INTERVAL
+};
+
+
+static void set_property(GObject *object, enum property prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GstWildDevine *element = GST_WILDDEVINE(object);
+	gboolean running, live;
+
+	GST_OBJECT_LOCK(element);
+
+	/* the kernel table and the caps are fixed by start().  fill()
+	 * relies on them matching rate, kernel_length and low_latency */
+	running = GST_STATE(element) > GST_STATE_READY;
+
+	switch(prop_id) {
+	case ARG_RATE:
+		if(running)
+			GST_WARNING_OBJECT(element, "cannot change rate while running");
+		else
+			element->rate = g_value_get_int(value);
+		break;
+
+	case ARG_KERNEL_LENGTH:
+		if(running)
+			GST_WARNING_OBJECT(element, "cannot change kernel-length while running");
+		else
+			/* must be even */
+			element->kernel_length = (g_value_get_int(value) + 1) & ~1;
+		break;
+
+	case ARG_LOW_LATENCY:
+		if(running)
+			GST_WARNING_OBJECT(element, "cannot change low-latency while running");
+		else
+			element->low_latency = g_value_get_boolean(value);
+		break;
+
+	case ARG_RECORD_LOCATION:
+		g_free(element->record_location);
+		element->record_location = g_value_dup_string(value);
+		break;
+
+	case ARG_REPLAY_LOCATION:
+		g_free(element->replay_location);
+		element->replay_location = g_value_dup_string(value);
+		break;
+
+	case ARG_REPLAY_FAST:
+		element->replay_fast = g_value_get_boolean(value);
+		break;
+
+	case ARG_SYNTHESIZE:
+		element->synthesize = g_value_get_boolean(value);
+		break;
+
+	case ARG_DEVICE_PATH:
+		g_free(element->device_path);
+		element->device_path = g_value_dup_string(value);
+		break;
+
+	case ARG_DEVICE_SERIAL:
+		g_free(element->device_serial);
+		element->device_serial = g_value_dup_string(value);
+		break;
+
+	case ARG_TELEMETRY_INTERVAL:
+		element->telemetry_interval = g_value_get_uint64(value);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	/* only the device, or a replay at the recorded pace, is live */
+	live = !(element->replay_fast && (element->replay_location || element->synthesize));
+
+	GST_OBJECT_UNLOCK(element);
+
+	/* 1/10th of a second.  can be overridden by setting blocksize
+	 * afterwards */
+	if(prop_id == ARG_RATE && !running)
+		gst_base_src_set_blocksize(GST_BASE_SRC(element), MAX(g_value_get_int(value) / 10, 1) * UNIT_SIZE);
+	gst_base_src_set_live(GST_BASE_SRC(element), live);
+}
+
+
+static void get_property(GObject *object, enum property prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstWildDevine *element = GST_WILDDEVINE(object);
+
+	GST_OBJECT_LOCK(element);
+
+	switch(prop_id) {
+	case ARG_VERSION:
+		g_value_set_uint64(value, element->version);
+		break;
+
+	case ARG_SERIAL:
+		g_value_set_uint64(value, element->serial);
+		break;
+
+	case ARG_PLL_LOCKED:
 		g_value_set_boolean(value, element->pll_locked);
 		break;
 
+	case ARG_RATE:
+		g_value_set_int(value, element->rate);
+		break;
+
+	case ARG_KERNEL_LENGTH:
+		g_value_set_int(value, element->kernel_length);
+		break;
+
+	case ARG_LOW_LATENCY:
+		g_value_set_boolean(value, element->low_latency);
+		break;
+
+	case ARG_RECORD_LOCATION:
+		g_value_set_string(value, element->record_location);
+		break;
+
+	case ARG_REPLAY_LOCATION:
+		g_value_set_string(value, element->replay_location);
+		break;
+
+	case ARG_REPLAY_FAST:
+		g_value_set_boolean(value, element->replay_fast);
+		break;
+
+	case ARG_SYNTHESIZE:
+		g_value_set_boolean(value, element->synthesize);
+		break;
+
+	case ARG_DEVICE_PATH:
+		g_value_set_string(value, element->device_path);
+		break;
+
+	case ARG_DEVICE_SERIAL:
+		g_value_set_string(value, element->device_serial);
+		break;
+
+	case ARG_CLOCK_OFFSET:
+		g_value_set_int64(value, element->clock_offset);
+		break;
+
+	case ARG_CLOCK_DRIFT:
+		g_value_set_double(value, element->clock_drift);
+		break;
+
+	case ARG_PHASE_ERROR_RMS:
+		g_value_set_double(value, element->phase_error_rms);
+		break;
+
+	case ARG_SAMPLE_PERIOD:
+		g_value_set_int64(value, element->sample_period);
+		break;
+
+	case ARG_LOCK_TIME:
+		g_value_set_uint64(value, element->lock_time);
+		break;
+
+	case ARG_SAMPLES_REJECTED:
+		g_value_set_uint64(value, element->samples_rejected);
+		break;
+
+	case ARG_SAMPLES_DROPPED:
+		g_value_set_uint64(value, element->samples_dropped);
+		break;
+
+	case ARG_TELEMETRY_INTERVAL:
+		g_value_set_uint64(value, element->telemetry_interval);
+		break;
+
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -644,10 +1967,21 @@ static void finalize(GObject *object)
 	GstWildDevine *element = GST_WILDDEVINE(object);
 
 	g_assert(element->collect_thread == NULL);
-	g_assert(element->queue == NULL);
-
-	libusb_exit(element->usb_context);
-	element->usb_context = NULL;
+	g_assert(element->collector == NULL);
+
+	g_free(element->ring);
+	element->ring = NULL;
+	g_free(element->kernels);
+	element->kernels = NULL;
+	g_free(element->record_location);
+	element->record_location = NULL;
+	g_free(element->replay_location);
+	element->replay_location = NULL;
+
+	g_free(element->device_path);
+	element->device_path = NULL;
+	g_free(element->device_serial);
+	element->device_serial = NULL;
 	g_mutex_clear(&element->queue_lock);
 	g_cond_clear(&element->queue_data_avail);
 
@@ -667,7 +2001,7 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE(
 		"audio/x-raw, " \
 			"format = (string) " GST_AUDIO_NE(F32) ", " \
 			"channels = (int) 2, " \
-			"rate = (int) " G_STRINGIFY(RATE) ", " \
+			"rate = (int) [1, MAX], " \
 			"layout = (string) interleaved, " \
 			"channel-mask = (bitmask) 0"
 	)
@@ -681,11 +2015,15 @@ static void gst_wilddevine_class_init(GstWildDevineClass *klass)
 	GstBaseSrcClass *src_class = GST_BASE_SRC_CLASS(klass);
 
 	object_class->finalize = GST_DEBUG_FUNCPTR(finalize);
+	object_class->set_property = GST_DEBUG_FUNCPTR(set_property);
 	object_class->get_property = GST_DEBUG_FUNCPTR(get_property);
 
+	src_class->get_caps = GST_DEBUG_FUNCPTR(get_caps);
+	src_class->query = GST_DEBUG_FUNCPTR(query);
 	src_class->start = GST_DEBUG_FUNCPTR(start);
 	src_class->stop = GST_DEBUG_FUNCPTR(stop);
 	src_class->unlock = GST_DEBUG_FUNCPTR(unlock);
+	src_class->unlock_stop = GST_DEBUG_FUNCPTR(unlock_stop);
 	src_class->fill = GST_DEBUG_FUNCPTR(fill);
 
 	gst_element_class_set_details_simple(element_class, 
@@ -715,7 +2053,7 @@ static void gst_wilddevine_class_init(GstWildDevineClass *klass)
 		g_param_spec_uint64(
 			"serial",
 			"Serial number",
-			"Hardware serial number.",
+			"Hardware serial number, as reported by the device in its data stream.  This is not the USB serial number string matched by device-serial.",
 			0, G_MAXUINT64, 0,
 			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
 		)
@@ -732,6 +2070,210 @@ static void gst_wilddevine_class_init(GstWildDevineClass *klass)
 			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
 		)
 	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_RATE,
+		g_param_spec_int(
+			"rate",
+			"Sample rate",
+			"Sample rate of the output time series (Hz).  The device's samples are interpolated onto this rate.  Setting this sets blocksize to 1/10th of a second of samples.  Larger blocksizes are reduced to what the sample queue can hold, roughly half a minute.",
+			1, G_MAXINT, DEFAULT_RATE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_KERNEL_LENGTH,
+		g_param_spec_int(
+			"kernel-length",
+			"Kernel length",
+			"Length of the interpolation kernel in device samples.  Rounded up to an even number.  Longer kernels reject more aliasing but, unless low-latency is set, wait for more samples.",
+			2, MAX_KERNEL_LENGTH, DEFAULT_KERNEL_LENGTH,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_LOW_LATENCY,
+		g_param_spec_boolean(
+			"low-latency",
+			"Low latency",
+			"Use an asymmetric interpolation kernel that reaches only 1 device sample into the future instead of half the kernel length.  Reduces latency at the expense of phase distortion and aliasing.",
+			DEFAULT_LOW_LATENCY,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_RECORD_LOCATION,
+		g_param_spec_string(
+			"record-location",
+			"Recording file",
+			"If set, write every raw USB packet, with its time of arrival, to this file.  The recording can be replayed with replay-location.  Takes effect when the element is started.",
+			DEFAULT_RECORD_LOCATION,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_REPLAY_LOCATION,
+		g_param_spec_string(
+			"replay-location",
+			"Replay file",
+			"If set, read raw USB packets from this recording instead of from the device.  The stream ends at the end of the recording.  Takes effect when the element is started.",
+			DEFAULT_REPLAY_LOCATION,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_REPLAY_FAST,
+		g_param_spec_boolean(
+			"replay-fast",
+			"Replay fast",
+			"Feed replayed or synthesized packets as fast as the pipeline consumes them instead of at their recorded pace.  The element is then not a live source.",
+			DEFAULT_REPLAY_FAST,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_SYNTHESIZE,
+		g_param_spec_boolean(
+			"synthesize",
+			"Synthesize",
+			"Synthesize packets from a model photoplethysmograph and skin conductance instead of reading the device.  Overrides replay-location.  The packets' timing jitter is the same every time.",
+			DEFAULT_SYNTHESIZE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_DEVICE_PATH,
+		g_param_spec_string(
+			"device-path",
+			"Device path",
+			"If set, use only the device at this USB bus and port path, e.g., \"1-2.3\" as in /sys/bus/usb/devices.  If neither this nor device-serial is set, the first device not already in use is opened.",
+			DEFAULT_DEVICE_PATH,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_DEVICE_SERIAL,
+		g_param_spec_string(
+			"device-serial",
+			"Device serial number",
+			"If set, use only the device whose USB serial number string descriptor is this, as shown by lsusb -v and logged when a device is opened.  This is not the serial property, which the device reports only once it is streaming.",
+			DEFAULT_DEVICE_SERIAL,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_CLOCK_OFFSET,
+		g_param_spec_int64(
+			"clock-offset",
+			"Clock offset",
+			"Pipeline running time at which the device's sample clock read 0, extrapolated from the most recent sample at the nominal sample rate (ns).  Changes at a rate given by clock-drift.  Restarts if the device is reconnected.",
+			G_MININT64, G_MAXINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_CLOCK_DRIFT,
+		g_param_spec_double(
+			"clock-drift",
+			"Clock drift",
+			"Fractional difference between the device's sample rate, as measured by the pipeline clock, and its nominal rate of " G_STRINGIFY(DEVICE_RATE) " Hz (parts per million).",
+			-G_MAXDOUBLE, G_MAXDOUBLE, 0.,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_PHASE_ERROR_RMS,
+		g_param_spec_double(
+			"phase-error-rms",
+			"Phase error RMS",
+			"RMS of the difference between the samples' times of arrival and the reconstructed sample clock since the PLL was last reset (sample periods).",
+			0., G_MAXDOUBLE, 0.,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_SAMPLE_PERIOD,
+		g_param_spec_int64(
+			"sample-period",
+			"Sample period",
+			"The PLL's estimate of the device's sample period (ns).  0 if not yet known.",
+			0, G_MAXINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_LOCK_TIME,
+		g_param_spec_uint64(
+			"lock-time",
+			"Lock time",
+			"Time the PLL took to lock after it was last reset or lost lock (ns).  GST_CLOCK_TIME_NONE if it has not locked.",
+			0, G_MAXUINT64, GST_CLOCK_TIME_NONE,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_SAMPLES_REJECTED,
+		g_param_spec_uint64(
+			"samples-rejected",
+			"Samples rejected",
+			"Number of samples discarded because the sample period was not yet known.",
+			0, G_MAXUINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_SAMPLES_DROPPED,
+		g_param_spec_uint64(
+			"samples-dropped",
+			"Samples dropped",
+			"Number of samples discarded because the streaming thread had fallen too far behind.",
+			0, G_MAXUINT64, 0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		ARG_TELEMETRY_INTERVAL,
+		g_param_spec_uint64(
+			"telemetry-interval",
+			"Telemetry interval",
+			"Post a \"telemetry\" element message with the clock recovery's state this often (ns).  0 disables.",
+			0, G_MAXUINT64, DEFAULT_TELEMETRY_INTERVAL,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT
+		)
+	);
 }
 
 
@@ -743,16 +2285,44 @@ static void gst_wilddevine_init(GstWildDevine *element)
 
 	gst_base_src_set_live(basesrc, TRUE);
 	gst_base_src_set_format(basesrc, GST_FORMAT_TIME);
-	gst_base_src_set_blocksize(basesrc, RATE / 10 * UNIT_SIZE);	/* 1/10th of a second */
 
-	libusb_init(&element->usb_context);
+	element->usb_context = NULL;
 	element->usb_handle = NULL;
+	element->device_path = NULL;
+	element->device_serial = NULL;
+	element->hotplug_registered = FALSE;
 
-	element->version = element->serial = -1;
+	element->record_location = NULL;
+	element->record_file = NULL;
+	element->replay_location = NULL;
+	element->replay_file = NULL;
+	element->replay_fast = DEFAULT_REPLAY_FAST;
+	element->synthesize = DEFAULT_SYNTHESIZE;
 
-	element->queue = NULL;
+	element->version = element->serial = -1;
+	element->clock_offset = 0;
+	element->clock_drift = 0.;
+	element->phase_error_rms = 0.;
+	element->sample_period = 0;
+	element->lock_time = GST_CLOCK_TIME_NONE;
+	element->samples_rejected = element->samples_dropped = 0;
+	element->telemetry_interval = DEFAULT_TELEMETRY_INTERVAL;
+	element->last_telemetry = GST_CLOCK_TIME_NONE;
+
+	element->rate = DEFAULT_RATE;
+	element->kernel_length = DEFAULT_KERNEL_LENGTH;
+	element->low_latency = DEFAULT_LOW_LATENCY;
+	element->kernels = NULL;
+
+	element->ring = g_new(struct queued_sample, RING_SIZE);
+	element->ring_mask = RING_SIZE - 1;
+	element->ring_head = element->ring_tail = 0;
+	element->ring_waiting = FALSE;
+	element->ring_rebased = FALSE;
+	element->flushing = FALSE;
 	g_mutex_init(&element->queue_lock);
 	g_cond_init(&element->queue_data_avail);
+	element->collector = NULL;
 	element->collect_thread = NULL;
 	element->collect_status = GST_FLOW_OK;
 }
@@ -32,6 +32,9 @@
  */
 
 
+#include <stdio.h>
+
+
 #include <glib.h>
 #include <gst/gst.h>
 #include <gst/base/gstbasesrc.h>
@@ -41,6 +44,9 @@
 G_BEGIN_DECLS
 
 
+struct collector;
+
+
 /*
  * ============================================================================
  *
@@ -73,6 +79,20 @@ struct _GstWildDevineClass {
 };
 
 
+/*
+ * one reclocked sample as handed from the collection thread to the
+ * streaming thread
+ */
+
+
+struct queued_sample {
+	GstClockTime t;
+	GstClockTimeDiff dt;
+	gfloat scl;
+	gfloat ppg;
+};
+
+
 /**
  * GstWildDevine
  */
@@ -82,11 +102,35 @@ struct _GstWildDevine {
 	GstBaseSrc basesrc;
 
 	/*
-	 * usb context
+	 * usb context, shared with every other instance, and device
+	 * selection
 	 */
 
 	libusb_context *usb_context;
 	libusb_device_handle *usb_handle;
+	gchar *device_path;
+	gchar *device_serial;
+
+	/*
+	 * recovery from a lost device
+	 */
+
+	libusb_hotplug_callback_handle hotplug_handle;
+	gboolean hotplug_registered;
+	volatile gint device_arrived;
+	GstClockTime last_reconnect;
+
+	/*
+	 * raw packet recording and replay.  when replaying or
+	 * synthesizing the device is not opened
+	 */
+
+	gchar *record_location;
+	FILE *record_file;
+	gchar *replay_location;
+	FILE *replay_file;
+	gboolean replay_fast;
+	gboolean synthesize;
 
 	/*
 	 * hardware information
@@ -95,6 +139,31 @@ struct _GstWildDevine {
 	guint64 version;
 	guint64 serial;
 
+	/*
+	 * clock recovery telemetry.  the device's sample clock measured
+	 * against the pipeline clock, the PLL's state, and counts of
+	 * samples lost
+	 */
+
+	GstClockTimeDiff clock_offset;	/* ns */
+	gdouble clock_drift;	/* ppm */
+	gdouble phase_error_rms;	/* periods */
+	GstClockTimeDiff sample_period;	/* ns */
+	GstClockTime lock_time;	/* ns */
+	guint64 samples_rejected;
+	guint64 samples_dropped;
+	guint64 telemetry_interval;	/* ns, 0 = disabled */
+	GstClockTime last_telemetry;
+
+	/*
+	 * output format and interpolation kernel
+	 */
+
+	gint rate;
+	gint kernel_length;
+	gboolean low_latency;
+	gdouble *kernels;
+
 	/*
 	 * sample index
 	 */
@@ -102,15 +171,30 @@ struct _GstWildDevine {
 	guint64 next_offset;
 
 	/*
-	 * sample collection thread
+	 * sample collection.  samples are handed to the streaming thread
+	 * through a single-producer single-consumer ring.  head and tail
+	 * are free-running counts, masked to index the ring;  head is
+	 * written only by the collector (the shared USB event thread or
+	 * the replay thread), tail only by fill().  the lock and
+	 * condition variable are used only to put fill() to sleep when it
+	 * has run out of data, and only if ring_waiting is set does the
+	 * collector take the lock to wake it
 	 */
 
-	GList *queue;
+	struct queued_sample *ring;
+	guint ring_mask;	/* capacity - 1 */
+	volatile guint ring_head;	/* next slot to fill */
+	volatile guint ring_tail;	/* oldest sample still needed */
+	volatile gint ring_waiting;
+	volatile guint ring_rebase;	/* samples before this are stale */
+	volatile gint ring_rebased;	/* ring_rebase has been set */
 	GMutex queue_lock;
 	GCond queue_data_avail;
-	GThread *collect_thread;
+	struct collector *collector;
+	GThread *collect_thread;	/* replay only */
 	gboolean pll_locked;
 	gboolean stop_requested;
+	volatile gint flushing;	/* fill() unlocked */
 	GstFlowReturn collect_status;
 };
 
@@ -0,0 +1,168 @@
+#
+# =============================================================================
+#
+#                                   Preamble
+#
+# =============================================================================
+#
+
+
+"""
+Sidecar files recording face detection and tracking results.
+
+Face detection dominates the cost of processing a video, but its results
+do not depend on the gamma correction, mask layout or filtering applied
+afterwards.  gst-cardiac can record the geometry it assigns to each face
+processor so that later passes over the same video replay it and skip the
+detector altogether.
+
+The file is a short header followed by fixed-size little-endian records
+in timestamp order, so any record can be reached by seeking and the
+record for a given time found by bisection.  Each record is
+
+	timestamp	uint64	ns, PTS of the video frame
+	slot		int32	face processor index
+	kind		uint32	KIND_FACE or KIND_RETIRE
+	flags		uint32	FLAG_NOSE, FLAG_EYES
+	geometry	12 x int32	face, nose and eyes x, y, width, height
+
+Geometry is in full-resolution pixel coordinates.
+"""
+
+
+import struct
+
+
+__author__ = "Kipp Cannon <kcannon@cita.utoronto.ca>"
+__version__ = "FIXME"
+__date__ = "FIXME"
+
+
+__all__ = ["KIND_FACE", "KIND_RETIRE", "FaceCacheWriter", "FaceCacheReader"]
+
+
+#
+# =============================================================================
+#
+#                                 File Format
+#
+# =============================================================================
+#
+
+
+MAGIC = b"CARDFACE"
+VERSION = 1
+header = struct.Struct("<8sII")
+record = struct.Struct("<QiII12i")
+
+
+KIND_FACE = 0
+KIND_RETIRE = 1
+
+
+FLAG_NOSE = 1 << 0
+FLAG_EYES = 1 << 1
+
+
+geometry_keys = (
+	("x", "y", "width", "height"),
+	("nose->x", "nose->y", "nose->width", "nose->height"),
+	("eyes->x", "eyes->y", "eyes->width", "eyes->height")
+)
+
+
+def face_to_record(timestamp, slot, kind, face):
+	flags = 0
+	geometry = [face.get(key, 0) for key in geometry_keys[0]] if face is not None else [0] * 4
+	for flag, keys in ((FLAG_NOSE, geometry_keys[1]), (FLAG_EYES, geometry_keys[2])):
+		if face is not None and keys[0] in face:
+			flags |= flag
+			geometry += [face[key] for key in keys]
+		else:
+			geometry += [0] * 4
+	return record.pack(timestamp, slot, kind, flags, *geometry)
+
+
+def record_to_face(buf):
+	values = record.unpack(buf)
+	timestamp, slot, kind, flags = values[:4]
+	geometry = values[4:]
+	if kind != KIND_FACE:
+		return timestamp, slot, kind, None
+	face = dict(zip(geometry_keys[0], geometry[0:4]))
+	if flags & FLAG_NOSE:
+		face.update(zip(geometry_keys[1], geometry[4:8]))
+	if flags & FLAG_EYES:
+		face.update(zip(geometry_keys[2], geometry[8:12]))
+	return timestamp, slot, kind, face
+
+
+#
+# =============================================================================
+#
+#                               Reader / Writer
+#
+# =============================================================================
+#
+
+
+class FaceCacheWriter(object):
+	def __init__(self, fileobj):
+		self.fileobj = fileobj
+		self.fileobj.write(header.pack(MAGIC, VERSION, record.size))
+
+	def write_face(self, timestamp, slot, face):
+		self.fileobj.write(face_to_record(timestamp, slot, KIND_FACE, face))
+
+	def write_retire(self, timestamp, slot):
+		self.fileobj.write(face_to_record(timestamp, slot, KIND_RETIRE, None))
+
+	def flush(self):
+		self.fileobj.flush()
+
+	def close(self):
+		self.fileobj.close()
+
+
+class FaceCacheReader(object):
+	"""
+	Random-access reader.  len() gives the number of records, indexing
+	returns (timestamp, slot, kind, face) tuples, face is None for
+	KIND_RETIRE records.
+	"""
+	def __init__(self, fileobj):
+		self.fileobj = fileobj
+		magic, version, size = header.unpack(self.fileobj.read(header.size))
+		if magic != MAGIC:
+			raise ValueError("not a face cache file")
+		if version != VERSION or size != record.size:
+			raise ValueError("unsupported face cache version %d" % version)
+		self.fileobj.seek(0, 2)
+		self.n = (self.fileobj.tell() - header.size) // record.size
+
+	def __len__(self):
+		return self.n
+
+	def __getitem__(self, i):
+		if not 0 <= i < self.n:
+			raise IndexError(i)
+		self.fileobj.seek(header.size + i * record.size)
+		return record_to_face(self.fileobj.read(record.size))
+
+	def timestamp(self, i):
+		self.fileobj.seek(header.size + i * record.size)
+		return struct.unpack("<Q", self.fileobj.read(8))[0]
+
+	def bisect(self, timestamp):
+		"""
+		Index of the first record whose timestamp is greater than
+		timestamp.
+		"""
+		lo, hi = 0, self.n
+		while lo < hi:
+			mid = (lo + hi) // 2
+			if timestamp < self.timestamp(mid):
+				hi = mid
+			else:
+				lo = mid + 1
+		return lo
@@ -0,0 +1,149 @@
+#
+# =============================================================================
+#
+#                                   Preamble
+#
+# =============================================================================
+#
+
+
+"""
+Association of detected faces with persistent identities.
+
+The face detector reports faces in an arbitrary order that can change from
+one frame to the next.  To keep each face's time series bound to one
+person, the faces found in each frame are matched to the faces of the
+previous frame by solving the assignment problem (Hungarian algorithm)
+with a cost built from the overlap of the bounding boxes and the
+separation of their centres.
+"""
+
+
+import math
+
+
+__author__ = "Kipp Cannon <kcannon@cita.utoronto.ca>"
+__version__ = "FIXME"
+__date__ = "FIXME"
+
+
+__all__ = ["iou", "cost", "hungarian", "match"]
+
+
+#
+# =============================================================================
+#
+#                                  Geometry
+#
+# =============================================================================
+#
+
+
+def iou(a, b):
+	"""
+	Intersection over union of the bounding boxes of two faces.  Faces
+	are dictionaries with "x", "y", "width" and "height" keys.
+	"""
+	width = min(a["x"] + a["width"], b["x"] + b["width"]) - max(a["x"], b["x"])
+	height = min(a["y"] + a["height"], b["y"] + b["height"]) - max(a["y"], b["y"])
+	if width <= 0 or height <= 0:
+		return 0.
+	intersection = float(width * height)
+	return intersection / (a["width"] * a["height"] + b["width"] * b["height"] - intersection)
+
+
+def cost(a, b):
+	"""
+	Cost of identifying face a with face b.  Overlapping faces cost
+	1 - IoU, in [0, 1).  Faces that do not overlap cost 1 + the
+	separation of their centres in units of their mean size, so that
+	the assignment remains well-defined for fast-moving subjects.
+	"""
+	overlap = iou(a, b)
+	if overlap > 0.:
+		return 1. - overlap
+	dx = (a["x"] + a["width"] / 2.) - (b["x"] + b["width"] / 2.)
+	dy = (a["y"] + a["height"] / 2.) - (b["y"] + b["height"] / 2.)
+	size = (a["width"] + a["height"] + b["width"] + b["height"]) / 4.
+	return 1. + math.hypot(dx, dy) / size
+
+
+#
+# =============================================================================
+#
+#                                 Assignment
+#
+# =============================================================================
+#
+
+
+def hungarian(costs):
+	"""
+	Solve the assignment problem for the n x m cost matrix costs (a
+	sequence of n sequences of length m, n <= m).  Returns a list of
+	length n giving the column assigned to each row.  O(n^2 m).
+	"""
+	n = len(costs)
+	m = len(costs[0]) if n else 0
+	if n > m:
+		raise ValueError("cost matrix must not have more rows than columns")
+	inf = float("inf")
+	# row and column potentials, and the row assigned to each column.
+	# indexes are 1-based, row and column 0 are sentinels
+	u = [0.] * (n + 1)
+	v = [0.] * (m + 1)
+	p = [0] * (m + 1)
+	way = [0] * (m + 1)
+	for i in range(1, n + 1):
+		p[0] = i
+		j0 = 0
+		minv = [inf] * (m + 1)
+		used = [False] * (m + 1)
+		while p[j0]:
+			used[j0] = True
+			i0 = p[j0]
+			delta = inf
+			j1 = 0
+			for j in range(1, m + 1):
+				if not used[j]:
+					cur = costs[i0 - 1][j - 1] - u[i0] - v[j]
+					if cur < minv[j]:
+						minv[j] = cur
+						way[j] = j0
+					if minv[j] < delta:
+						delta = minv[j]
+						j1 = j
+			for j in range(m + 1):
+				if used[j]:
+					u[p[j]] += delta
+					v[j] -= delta
+				else:
+					minv[j] -= delta
+			j0 = j1
+		# augment along the alternating path
+		while j0:
+			j1 = way[j0]
+			p[j0] = p[j1]
+			j0 = j1
+	assignment = [None] * n
+	for j in range(1, m + 1):
+		if p[j]:
+			assignment[p[j] - 1] = j - 1
+	return assignment
+
+
+def match(previous, faces, max_cost = 2.):
+	"""
+	Match faces to the faces in previous with minimum total cost.
+	Returns a list of (index into previous, index into faces) pairs.
+	Pairs whose cost exceeds max_cost are not reported, leaving those
+	faces unmatched so they can be given new identities.
+	"""
+	if not previous or not faces:
+		return []
+	costs = [[cost(a, b) for b in faces] for a in previous]
+	if len(previous) <= len(faces):
+		pairs = enumerate(hungarian(costs))
+	else:
+		pairs = ((i, j) for j, i in enumerate(hungarian(list(zip(*costs)))))
+	return [(i, j) for i, j in pairs if costs[i][j] <= max_cost]
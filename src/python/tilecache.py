@@ -0,0 +1,196 @@
+#
+# =============================================================================
+#
+#                                   Preamble
+#
+# =============================================================================
+#
+
+
+"""
+Per-frame tile sums written by face2rgb's tile-location property.
+
+face2rgb can record, for every frame, the gamma-corrected R, G, B sums of
+each tile-size x tile-size block of pixels together with the face geometry
+in force for that frame.  The forehead, cheek and background sums for any
+mask built from whole tiles can then be computed from the tile sums alone,
+so mask experiments do not need to decode and scan the video again.
+
+The file is a header followed by fixed-size records in host byte order.
+The header is
+
+	magic		8 bytes	"CARDTILE"
+	version		uint32
+	width, height	uint32	frame size in pixels
+	tile_size	uint32	pixels
+	tiles_x, tiles_y	uint32	number of tiles across and down
+	counts		tiles_y x tiles_x uint32	pixels in each tile
+
+and each record is
+
+	timestamp	uint64	ns, PTS of the video frame
+	gamma		float64
+	geometry	12 x int32	face, nose and eyes x, y, width, height
+	sums		tiles_y x tiles_x x 3 float64	R, G, B sums
+"""
+
+
+import numpy
+import struct
+
+
+__author__ = "Kipp Cannon <kcannon@cita.utoronto.ca>"
+__version__ = "FIXME"
+__date__ = "FIXME"
+
+
+__all__ = ["TileCacheReader", "face_mask", "region_sums", "face2rgb"]
+
+
+#
+# =============================================================================
+#
+#                                 File Format
+#
+# =============================================================================
+#
+
+
+MAGIC = b"CARDTILE"
+VERSION = 1
+header = struct.Struct("=8s6I")
+
+
+MASK_BG = 0
+MASK_FOREHEAD = 1
+MASK_CHEEK = 2
+MASK_UNUSED = 3
+
+
+# must match face2rgb.c
+FACE_SCALE_FACTOR = 0.9
+
+
+geometry_keys = (
+	"x", "y", "width", "height",
+	"nose->x", "nose->y", "nose->width", "nose->height",
+	"eyes->x", "eyes->y", "eyes->width", "eyes->height"
+)
+
+
+#
+# =============================================================================
+#
+#                                    Reader
+#
+# =============================================================================
+#
+
+
+class TileCacheReader(object):
+	"""
+	Memory-mapped reader.  len() gives the number of frames.  The
+	attributes timestamps (ns), gamma and geometry are arrays with one
+	entry per frame, geometry having the 12 face, nose and eyes
+	values as columns;  sums is a (frames x tiles_y x tiles_x x 3)
+	array, and counts is the (tiles_y x tiles_x) array of pixel
+	counts.
+	"""
+	def __init__(self, filename):
+		with open(filename, "rb") as fileobj:
+			values = header.unpack(fileobj.read(header.size))
+		magic, version, self.width, self.height, self.tile_size, self.tiles_x, self.tiles_y = values
+		if magic != MAGIC:
+			raise ValueError("%s: not a tile sums file" % filename)
+		if version != VERSION:
+			raise ValueError("%s: unsupported tile sums version %d" % (filename, version))
+		self.counts = numpy.memmap(filename, dtype = numpy.uint32, mode = "r", offset = header.size, shape = (self.tiles_y, self.tiles_x))
+		record = numpy.dtype([
+			("timestamp", numpy.uint64),
+			("gamma", numpy.float64),
+			("geometry", numpy.int32, (12,)),
+			("sums", numpy.float64, (self.tiles_y, self.tiles_x, 3))
+		])
+		offset = header.size + self.counts.nbytes
+		with open(filename, "rb") as fileobj:
+			fileobj.seek(0, 2)
+			n = (fileobj.tell() - offset) // record.itemsize
+		self.records = numpy.memmap(filename, dtype = record, mode = "r", offset = offset, shape = (n,))
+		self.timestamps = self.records["timestamp"]
+		self.gamma = self.records["gamma"]
+		self.geometry = self.records["geometry"]
+		self.sums = self.records["sums"]
+
+	def __len__(self):
+		return len(self.records)
+
+	def face(self, i):
+		"""
+		Face geometry of frame i as a dictionary in the form reported
+		by the facedetect element.
+		"""
+		return dict(zip(geometry_keys, (int(v) for v in self.geometry[i])))
+
+
+#
+# =============================================================================
+#
+#                                    Masks
+#
+# =============================================================================
+#
+
+
+def face_mask(reader, face):
+	"""
+	Tile-resolution version of face2rgb's mask.  Each tile is assigned
+	to the region containing its centre.  Returns a (tiles_y x tiles_x)
+	array of MASK_* values.  Alternative mask definitions need only
+	return an array of the same form.
+	"""
+	width = face["width"] if face["width"] > 0 else reader.width
+	height = face["height"] if face["height"] > 0 else reader.height
+	ts = reader.tile_size
+	x = numpy.minimum(numpy.arange(reader.tiles_x) * ts + ts / 2., reader.width - 0.5)
+	y = numpy.minimum(numpy.arange(reader.tiles_y) * ts + ts / 2., reader.height - 0.5)
+	x, y = numpy.meshgrid(x, y)
+	fx = ((x - face["x"]) * 2. / width - 1.) / FACE_SCALE_FACTOR
+	fy = ((y - face["y"]) * 2. / height - 1.) / FACE_SCALE_FACTOR
+	mask = numpy.empty(x.shape, dtype = int)
+	mask.fill(MASK_UNUSED)
+	mask[y < face["eyes->y"]] = MASK_FOREHEAD
+	mask[(y >= face["eyes->y"] + face["eyes->height"]) & ((x < face["nose->x"]) | (x >= face["nose->x"] + face["nose->width"]))] = MASK_CHEEK
+	mask[fx**2 + fy**2 > 1.] = MASK_BG
+	return mask
+
+
+def region_sums(reader, i, mask):
+	"""
+	R, G, B sums and pixel count of each region of mask in frame i.
+	Returns a dictionary mapping MASK_* value to (sums, count).
+	"""
+	sums = reader.sums[i]
+	return dict((region, (sums[mask == region].sum(0), int(reader.counts[mask == region].sum()))) for region in (MASK_BG, MASK_FOREHEAD, MASK_CHEEK))
+
+
+def face2rgb(reader, mask_func = face_mask):
+	"""
+	Iterate over (timestamp, samples) pairs, where samples are the six
+	channels face2rgb would have produced with a mask computed at tile
+	resolution by mask_func(reader, face).  timestamp is in seconds.
+	"""
+	mask = None
+	geometry = None
+	for i in range(len(reader)):
+		if geometry is None or (reader.geometry[i] != geometry).any():
+			geometry = reader.geometry[i].copy()
+			mask = mask_func(reader, reader.face(i))
+		regions = region_sums(reader, i, mask)
+		bg_rgb, bg_area = regions[MASK_BG]
+		bg_y = 0.2126 * bg_rgb[0] + 0.7152 * bg_rgb[1] + 0.0722 * bg_rgb[2]
+		samples = []
+		for region in (MASK_FOREHEAD, MASK_CHEEK):
+			rgb, area = regions[region]
+			ratio = float(bg_area) / area if area else 0.
+			samples.extend(rgb * ratio / bg_y)
+		yield reader.timestamps[i] * 1e-9, samples